@@ -0,0 +1,77 @@
+/**
+ * @file redis_arena_bench.cc
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief reply parsing with RedisReplyArena against hiredis' default malloc per object, no server needed
+ *        g++ -std=c++17 -O2 -I.. redis_arena_bench.cc ../redis_arena.cc -lhiredis
+ *        ./a.out [elements] [element bytes] [iterations]
+ *        each iteration feeds one array reply of bulk strings, the shape of LRANGE or HGETALL
+ * @version 0.1
+ * @date 2024-06-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "redis_arena.h"
+
+namespace {
+
+std::string ArrayReply(size_t elements, size_t bytes) {
+    std::string value(bytes, 'x');
+    std::string resp = "*" + std::to_string(elements) + "\r\n";
+    for (size_t i = 0; i < elements; ++i) {
+        resp += "$" + std::to_string(bytes) + "\r\n" + value + "\r\n";
+    }
+    return resp;
+}
+
+/** feeds resp iterations times, each reply is freed before the next one is read, nanoseconds per reply */
+double Measure(redisReader* reader, void (*release)(void*), const std::string& resp, size_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < iterations; ++n) {
+        void* reply = nullptr;
+        if (redisReaderFeed(reader, resp.data(), resp.size()) != REDIS_OK
+            || redisReaderGetReply(reader, &reply) != REDIS_OK || !reply) {
+            throw std::runtime_error(std::string("reader error : ") + reader->errstr);
+        }
+        release(reply);
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return (double)nanos / iterations;
+}
+
+}
+
+int main(int argc, char** argv) {
+    size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100;
+    size_t bytes = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+    size_t iterations = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 100000;
+    auto resp = ArrayReply(elements, bytes);
+
+    try {
+        auto mallocReader = redisReaderCreate();
+        auto mallocNanos = Measure(mallocReader, &freeReplyObject, resp, iterations);
+        redisReaderFree(mallocReader);
+
+        auto arena = new RedisReplyArena();
+        auto arenaReader = redisReaderCreateWithFunctions(RedisReplyArena::Functions());
+        arenaReader->privdata = arena;
+        auto arenaNanos = Measure(arenaReader, &RedisReplyArena::FreeReply, resp, iterations);
+        redisReaderFree(arenaReader);
+        arena->Detach();
+
+        printf("elements %zu bytes %zu iterations %zu\n", elements, bytes, iterations);
+        printf("malloc %10.1f ns/reply\n", mallocNanos);
+        printf("arena  %10.1f ns/reply\n", arenaNanos);
+    } catch (const std::exception& e) {
+        std::cout << "redis arena bench exception : " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
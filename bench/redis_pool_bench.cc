@@ -0,0 +1,126 @@
+/**
+ * @file redis_pool_bench.cc
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief checkout and return latency of RedisConnectPool against the mutex pool it replaced, per thread count
+ *        g++ -std=c++17 -O2 -I.. redis_pool_bench.cc ../redis.cc ../redis_arena.cc ../redis_metrics.cc -lhiredis -lpthread
+ *        ./a.out [host] [port] [max threads] [iterations] [get]
+ *        thread counts 1, 2, 4 ... up to max threads (default 128) are run one after the other,
+ *        with "get" every checkout also sends GET, without it only the pool itself is measured.
+ *        contention only shows with as many cores as threads, run it on a multi-core host against a real server
+ * @version 0.1
+ * @date 2024-06-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "redis.h"
+
+namespace {
+
+/** the pool before the lock-free rewrite, a mutex around a vector of free connections */
+class MutexPool {
+public:
+    void Connect(const std::string& ip, uint16_t port, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            auto conn = std::make_shared<RedisClient>();
+            if (!conn->ConnectWithTimeout(ip, port, 50)) {
+                throw std::runtime_error("mutex pool connect failed");
+            }
+            m_connections.push_back(conn);
+            m_freeconnections.push_back(conn);
+        }
+    }
+    RedisClient::Ptr Get() {
+        std::lock_guard guard(m_mutex);
+        if (m_freeconnections.empty()) {
+            throw std::runtime_error("without redis connection");
+        }
+        auto conn = m_freeconnections.front();
+        m_freeconnections.erase(m_freeconnections.begin());
+        return conn;
+    }
+    void Return(const RedisClient::Ptr& conn) {
+        std::lock_guard guard(m_mutex);
+        m_freeconnections.push_back(conn);
+    }
+private:
+    std::mutex m_mutex;
+    std::vector<RedisClient::Ptr> m_connections;
+    std::vector<RedisClient::Ptr> m_freeconnections;
+};
+
+/** runs body iterations times on each of threads threads, nanoseconds per call */
+template <typename Body>
+double Measure(size_t threads, size_t iterations, Body body) {
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&body, iterations]() {
+            for (size_t n = 0; n < iterations; ++n) {
+                body();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return (double)nanos / (threads * iterations);
+}
+
+}
+
+int main(int argc, char** argv) {
+    std::string host = argc > 1 ? argv[1] : "127.0.0.1";
+    uint16_t port = argc > 2 ? (uint16_t)std::atoi(argv[2]) : 6379;
+    size_t maxThreads = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 128;
+    size_t iterations = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 100000;
+    bool send = argc > 5 && std::string(argv[5]) == "get";
+
+    printf("cores %u iterations %zu%s\n", std::thread::hardware_concurrency(), iterations, send ? " with GET" : "");
+    printf("%8s %16s %16s\n", "threads", "mutex ns/op", "lock-free ns/op");
+    /** one connection per thread, neither pool ever runs dry so only checkout and return are compared */
+    try {
+        for (size_t threads = 1; threads <= std::max<size_t>(maxThreads, 1); threads *= 2) {
+            MutexPool mutexPool;
+            mutexPool.Connect(host, port, threads);
+            auto mutexNanos = Measure(threads, iterations, [&mutexPool, send]() {
+                auto conn = mutexPool.Get();
+                if (send) {
+                    conn->get("redis_pool_bench");
+                }
+                mutexPool.Return(conn);
+            });
+
+            RedisConnectPoolOptions options;
+            options.host = host;
+            options.port = port;
+            options.min_connections = threads;
+            options.max_connections = threads;
+            options.validate_idle_ms = 0;
+            RedisConnectPool pool;
+            pool.Connect(options);
+            auto poolNanos = Measure(threads, iterations, [&pool, send]() {
+                RedisConnectPoolGuard guard(&pool);
+                auto conn = guard.Get();
+                if (send) {
+                    conn->get("redis_pool_bench");
+                }
+            });
+            printf("%8zu %16.1f %16.1f\n", threads, mutexNanos, poolNanos);
+        }
+    } catch (const std::exception& e) {
+        fprintf(stderr, "redis pool bench exception : %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,417 @@
+/**
+ * @file byte_array.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief compact binary form of reflected structs
+ * @version 0.1
+ * @date 2024-06-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____BYTE_ARRAY_H____
+#define ____BYTE_ARRAY_H____
+
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "reflection.h"
+
+/**
+ * layout, little endian throughout
+ *   value      : varint schema version, struct
+ *   struct     : varint payload size, members in the order they are listed
+ *   integer    : LEB128 varint, signed ones zigzag encoded first
+ *   bool       : one byte
+ *   float      : 4 / 8 bytes IEEE 754
+ *   string     : varint size, bytes
+ *   optional   : one byte present flag, value
+ *   container  : varint count, elements (maps as key, value), std::array without count
+ * members may be appended to a struct without a version bump, older readers skip them
+ * and newer readers keep the default of members an older writer did not know.
+ * any other change of the member list needs a new BYTE_ARRAY_SCHEMA_VERSION
+ */
+#define BYTE_ARRAY_REFLECTION(STRUCT_NAME, ...)                                                                   \
+	inline void to_byte_array(ByteArraySerialize& serialize, const STRUCT_NAME& value) {                          \
+		MAKE_ARG_LIST(GET_ARG_COUNT(__VA_ARGS__), BYTE_ARRAY_SERIALIZS_CONCAT, __VA_ARGS__);                      \
+	}                                                                                                             \
+	inline void from_byte_array(ByteArrayDeserialize& deserialize, STRUCT_NAME& value) {                          \
+		MAKE_ARG_LIST(GET_ARG_COUNT(__VA_ARGS__), BYTE_ARRAY_DESERIALIZS_CONCAT, __VA_ARGS__);                    \
+	}
+
+#define BYTE_ARRAY_SCHEMA_VERSION(STRUCT_NAME, VERSION) \
+	constexpr uint32_t byte_array_version(const STRUCT_NAME*) { return VERSION; }
+
+class ByteArraySerialize;
+class ByteArrayDeserialize;
+
+namespace byte_array_detail {
+template <typename type, typename = void>
+struct has_byte_array : std::false_type {};
+template <typename type>
+struct has_byte_array<type, std::void_t<decltype(to_byte_array(std::declval<ByteArraySerialize&>(), std::declval<const type&>()))>> : std::true_type {};
+
+/** RAPIDJSON_REFLECTION_PARSE lists work as well */
+struct null_visitor {
+	template <typename member>
+	void operator()(const char*, const member&) const {}
+};
+template <typename type, typename = void>
+struct has_visit_fields : std::false_type {};
+template <typename type>
+struct has_visit_fields<type, std::void_t<decltype(visit_fields(std::declval<const type&>(), null_visitor {}))>> : std::true_type {};
+
+template <typename type, typename = void>
+struct has_version : std::false_type {};
+template <typename type>
+struct has_version<type, std::void_t<decltype(byte_array_version(static_cast<const type*>(nullptr)))>> : std::true_type {};
+
+template <typename type>
+struct is_optional : std::false_type {};
+template <typename type>
+struct is_optional<std::optional<type>> : std::true_type {};
+template <typename type>
+struct is_pair : std::false_type {};
+template <typename first, typename second>
+struct is_pair<std::pair<first, second>> : std::true_type {};
+template <typename type>
+struct is_std_array : std::false_type {};
+template <typename type, size_t size>
+struct is_std_array<std::array<type, size>> : std::true_type {};
+
+template <typename type, typename = void>
+struct is_container : std::false_type {};
+template <typename type>
+struct is_container<type, std::void_t<typename type::value_type, decltype(std::declval<const type&>().begin()),
+	decltype(std::declval<const type&>().size()), decltype(std::declval<type&>().clear())>> : std::true_type {};
+template <typename type, typename = void>
+struct is_map : std::false_type {};
+template <typename type>
+struct is_map<type, std::void_t<typename type::key_type, typename type::mapped_type>> : std::true_type {};
+template <typename type, typename = void>
+struct has_push_back : std::false_type {};
+template <typename type>
+struct has_push_back<type, std::void_t<decltype(std::declval<type&>().push_back(std::declval<typename type::value_type>()))>> : std::true_type {};
+template <typename type, typename = void>
+struct has_reserve : std::false_type {};
+template <typename type>
+struct has_reserve<type, std::void_t<decltype(std::declval<type&>().reserve(size_t(0)))>> : std::true_type {};
+
+template <typename type>
+constexpr bool is_reflected_v = has_byte_array<type>::value || has_visit_fields<type>::value;
+template <typename>
+constexpr bool dependent_false_v = false;
+
+template <typename type>
+constexpr uint32_t version_of() {
+	if constexpr (has_version<type>::value) {
+		return byte_array_version(static_cast<const type*>(nullptr));
+	} else {
+		return 0;
+	}
+}
+}
+
+class ByteArraySerialize {
+	friend class ByteArrayConverter;
+public:
+	/** one member, called by to_byte_array */
+	template <typename type>
+	auto add_from(const type& value) -> void {
+		write_value(value);
+	}
+
+private:
+	explicit ByteArraySerialize(std::string& buffer) : _buffer (buffer) {}
+
+	auto write_varint(uint64_t value) -> void {
+		while (value >= 0x80) {
+			_buffer.push_back((char)(value | 0x80));
+			value >>= 7;
+		}
+		_buffer.push_back((char)value);
+	}
+
+	template <typename type>
+	auto write_fixed(type value) -> void {
+		char bytes[sizeof(type)];
+		for (size_t i = 0; i < sizeof(type); ++i) {
+			bytes[i] = (char)(value >> (8 * i));
+		}
+		_buffer.append(bytes, sizeof(type));
+	}
+
+	template <typename type>
+	auto write_value(const type& value) -> void {
+		namespace detail = byte_array_detail;
+		if constexpr (std::is_same_v<type, bool>) {
+			_buffer.push_back(value ? 1 : 0);
+		} else if constexpr (std::is_enum_v<type>) {
+			write_value(static_cast<std::underlying_type_t<type>>(value));
+		} else if constexpr (std::is_integral_v<type> && std::is_signed_v<type>) {
+			/** zigzag, small negative numbers stay short */
+			auto number = (int64_t)value;
+			write_varint(((uint64_t)number << 1) ^ (uint64_t)(number >> 63));
+		} else if constexpr (std::is_integral_v<type>) {
+			write_varint((uint64_t)value);
+		} else if constexpr (std::is_same_v<type, float>) {
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			write_fixed(bits);
+		} else if constexpr (std::is_same_v<type, double>) {
+			uint64_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			write_fixed(bits);
+		} else if constexpr (std::is_same_v<type, std::string> || std::is_same_v<type, std::string_view>) {
+			write_varint(value.size());
+			_buffer.append(value.data(), value.size());
+		} else if constexpr (detail::is_optional<type>::value) {
+			_buffer.push_back(value ? 1 : 0);
+			if (value) {
+				write_value(*value);
+			}
+		} else if constexpr (detail::is_pair<type>::value) {
+			write_value(value.first);
+			write_value(value.second);
+		} else if constexpr (detail::is_std_array<type>::value) {
+			for (auto& element : value) {
+				write_value(element);
+			}
+		} else if constexpr (detail::is_reflected_v<type>) {
+			write_struct(value);
+		} else if constexpr (detail::is_container<type>::value) {
+			write_varint(value.size());
+			for (auto& element : value) {
+				write_value(element);
+			}
+		} else {
+			static_assert(detail::dependent_false_v<type>, "type can not be written as byte array, list its members with BYTE_ARRAY_REFLECTION");
+		}
+	}
+
+	template <typename type>
+	auto write_struct(const type& value) -> void {
+		/** one byte of size is reserved, members of larger structs are moved once it is known */
+		auto offset = _buffer.size();
+		_buffer.push_back(0);
+		if constexpr (byte_array_detail::has_byte_array<type>::value) {
+			to_byte_array(*this, value);
+		} else {
+			visit_fields(value, [this](const char*, const auto& member) { write_value(member); });
+		}
+		auto size = _buffer.size() - offset - 1;
+		if (size < 0x80) {
+			_buffer[offset] = (char)size;
+			return;
+		}
+		char bytes[10];
+		size_t count = 0;
+		for (auto rest = (uint64_t)size; ; rest >>= 7) {
+			bytes[count++] = (char)(rest >= 0x80 ? (rest | 0x80) : rest);
+			if (rest < 0x80) {
+				break;
+			}
+		}
+		_buffer.replace(offset, 1, bytes, count);
+	}
+
+private:
+	std::string& _buffer;
+};
+
+class ByteArrayDeserialize {
+	friend class ByteArrayConverter;
+public:
+	/** one member, called by from_byte_array. members past the end of the struct keep their value */
+	template <typename type>
+	auto get_from(type& value) -> void {
+		if (_position < _end) {
+			read_value(value);
+		}
+	}
+
+private:
+	ByteArrayDeserialize(const char* data, size_t size) : _data (data), _position (0), _end (size) {}
+
+	auto need(size_t size) -> void {
+		if (_end - _position < size) {
+			throw std::runtime_error("byte array truncated");
+		}
+	}
+
+	auto read_varint() -> uint64_t {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			need(1);
+			auto byte = (uint8_t)_data[_position++];
+			value |= (uint64_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		throw std::runtime_error("byte array varint too long");
+	}
+
+	template <typename type>
+	auto read_fixed() -> type {
+		need(sizeof(type));
+		type value = 0;
+		for (size_t i = 0; i < sizeof(type); ++i) {
+			value |= (type)(uint8_t)_data[_position++] << (8 * i);
+		}
+		return value;
+	}
+
+	auto read_size() -> size_t {
+		auto size = read_varint();
+		/** every element takes at least one byte, a larger count is a corrupt value, not a reason to allocate */
+		if (size > _end - _position) {
+			throw std::runtime_error("byte array size out of range");
+		}
+		return (size_t)size;
+	}
+
+	template <typename type>
+	auto read_value(type& value) -> void {
+		namespace detail = byte_array_detail;
+		if constexpr (std::is_same_v<type, bool>) {
+			need(1);
+			value = _data[_position++] != 0;
+		} else if constexpr (std::is_enum_v<type>) {
+			std::underlying_type_t<type> number {};
+			read_value(number);
+			value = static_cast<type>(number);
+		} else if constexpr (std::is_integral_v<type> && std::is_signed_v<type>) {
+			auto zigzag = read_varint();
+			value = (type)(int64_t)((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+		} else if constexpr (std::is_integral_v<type>) {
+			value = (type)read_varint();
+		} else if constexpr (std::is_same_v<type, float>) {
+			auto bits = read_fixed<uint32_t>();
+			memcpy(&value, &bits, sizeof(bits));
+		} else if constexpr (std::is_same_v<type, double>) {
+			auto bits = read_fixed<uint64_t>();
+			memcpy(&value, &bits, sizeof(bits));
+		} else if constexpr (std::is_same_v<type, std::string>) {
+			auto size = read_size();
+			value.assign(_data + _position, size);
+			_position += size;
+		} else if constexpr (detail::is_optional<type>::value) {
+			need(1);
+			if (_data[_position++]) {
+				typename type::value_type inner {};
+				read_value(inner);
+				value = std::move(inner);
+			} else {
+				value.reset();
+			}
+		} else if constexpr (detail::is_pair<type>::value) {
+			read_value(const_cast<std::remove_const_t<typename type::first_type>&>(value.first));
+			read_value(value.second);
+		} else if constexpr (detail::is_std_array<type>::value) {
+			for (auto& element : value) {
+				read_value(element);
+			}
+		} else if constexpr (detail::is_reflected_v<type>) {
+			read_struct(value);
+		} else if constexpr (detail::is_container<type>::value) {
+			auto count = read_size();
+			value.clear();
+			if constexpr (detail::has_reserve<type>::value) {
+				value.reserve(count);
+			}
+			for (size_t i = 0; i < count; ++i) {
+				if constexpr (detail::is_map<type>::value) {
+					std::pair<typename type::key_type, typename type::mapped_type> element {};
+					read_value(element.first);
+					read_value(element.second);
+					value.insert(std::move(element));
+				} else {
+					typename type::value_type element {};
+					read_value(element);
+					if constexpr (detail::has_push_back<type>::value) {
+						value.push_back(std::move(element));
+					} else {
+						value.insert(std::move(element));
+					}
+				}
+			}
+		} else {
+			static_assert(detail::dependent_false_v<type>, "type can not be read from byte array, list its members with BYTE_ARRAY_REFLECTION");
+		}
+	}
+
+	template <typename type>
+	auto read_struct(type& value) -> void {
+		auto size = read_size();
+		auto end = _end;
+		_end = _position + size;
+		if constexpr (byte_array_detail::has_byte_array<type>::value) {
+			from_byte_array(*this, value);
+		} else {
+			visit_fields(value, [this](const char*, auto& member) { get_from(member); });
+		}
+		/** members a newer writer appended are skipped */
+		_position = _end;
+		_end = end;
+	}
+
+private:
+	const char* _data;
+	size_t _position;
+	size_t _end;
+};
+
+/**
+ * @brief entry points, e.g.
+ *        struct User { std::string name; int32_t age; std::vector<std::string> tags; };
+ *        BYTE_ARRAY_REFLECTION(User, name, age, tags)
+ *        auto bytes = ByteArrayConverter::serialise(user);
+ */
+class [[maybe_unused]] ByteArrayConverter {
+public:
+	template <typename object>
+	static auto serialise(const object& obj) -> std::string {
+		std::string buffer;
+		serialise(obj, buffer);
+		return buffer;
+	}
+
+	/** appends to buffer, lets a caller reuse its allocation */
+	template <typename object>
+	static auto serialise(const object& obj, std::string& buffer) -> void {
+		static_assert(byte_array_detail::is_reflected_v<object>, "list the members with BYTE_ARRAY_REFLECTION or RAPIDJSON_REFLECTION_PARSE");
+		ByteArraySerialize _serialize(buffer);
+		_serialize.write_varint(byte_array_detail::version_of<object>());
+		_serialize.write_struct(obj);
+	}
+
+	/** throws std::runtime_error on a corrupt value or one of another schema version */
+	template <typename object>
+	static auto deserialise(std::string_view bytes, object& obj) -> void {
+		static_assert(byte_array_detail::is_reflected_v<object>, "list the members with BYTE_ARRAY_REFLECTION or RAPIDJSON_REFLECTION_PARSE");
+		ByteArrayDeserialize _deserialize(bytes.data(), bytes.size());
+		auto version = _deserialize.read_varint();
+		if (version != byte_array_detail::version_of<object>()) {
+			throw std::runtime_error("byte array schema version " + std::to_string(version) + " is not "
+				+ std::to_string(byte_array_detail::version_of<object>()));
+		}
+		_deserialize.read_struct(obj);
+	}
+
+	template <typename object>
+	static auto deserialise(std::string_view bytes) -> object {
+		object obj {};
+		deserialise(bytes, obj);
+		return obj;
+	}
+};
+
+#endif // ! ____BYTE_ARRAY_H____
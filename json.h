@@ -294,10 +294,14 @@ RAPIDJSON_REFLECTION_OFF(33010 4267 4996 26451 26495 26819)
 
 #define RAPIDJSON_REFLECTION_TO(v1) _serialise.add_from(#v1, cls.v1);
 #define RAPIDJSON_REFLECTION_FROM(v1) _deserialiseValue.get_from(#v1, cls.v1);
+/** calls _visitor(name, member) for every listed member, used by RedisClient::hset_object / hget_object */
+#define RAPIDJSON_REFLECTION_VISIT(v1) _visitor(#v1, cls.v1);
 
 #define RAPIDJSON_REFLECTION_PARSE(Type, ...)                                                                                                                           \
     inline void to_json(Serialise& _serialise ,const Type& cls) { RAPIDJSON_REFLECTION_EXPAND(RAPIDJSON_REFLECTION_PASTE(RAPIDJSON_REFLECTION_TO,__VA_ARGS__)) }        \
-    inline void from_json(DomValue _deserialiseValue, Type& cls) {RAPIDJSON_REFLECTION_EXPAND(RAPIDJSON_REFLECTION_PASTE(RAPIDJSON_REFLECTION_FROM,__VA_ARGS__)) }		
+    inline void from_json(DomValue _deserialiseValue, Type& cls) {RAPIDJSON_REFLECTION_EXPAND(RAPIDJSON_REFLECTION_PASTE(RAPIDJSON_REFLECTION_FROM,__VA_ARGS__)) }      \
+    template <typename Visitor> inline void visit_fields(const Type& cls, Visitor&& _visitor) { RAPIDJSON_REFLECTION_EXPAND(RAPIDJSON_REFLECTION_PASTE(RAPIDJSON_REFLECTION_VISIT,__VA_ARGS__)) } \
+    template <typename Visitor> inline void visit_fields(Type& cls, Visitor&& _visitor) { RAPIDJSON_REFLECTION_EXPAND(RAPIDJSON_REFLECTION_PASTE(RAPIDJSON_REFLECTION_VISIT,__VA_ARGS__)) }
 	
 
 class Converter;
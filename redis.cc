@@ -1,6 +1,201 @@
 #include "redis.h"
-#include <iostream>
+#include "redis_arena.h"
+#include "redis_metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
 
+static void CheckReply(const redisReply* reply, const char* command) {
+    if (!reply) {
+        throw std::runtime_error(std::string("redis error, command : ") + command
+            + ", error message : connection lost");
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        throw std::runtime_error(std::string("redis error, command : ") + command
+            + ", error message : " + std::string(reply->str, reply->len));
+    }
+}
+bool RedisReplyConverter::Status(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_STATUS) {
+        return strcmp(reply->str, "OK") == 0;
+    } else if (reply->type == REDIS_REPLY_NIL) {
+        return false;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+bool RedisReplyConverter::Boolean(const redisReply* reply, const char* command) {
+    if (!reply) {
+        return false;
+    }
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        return reply->integer > 0;
+    } else if (reply->type == REDIS_REPLY_STATUS) {
+        return strcmp(reply->str, "OK") == 0;
+    } else if (reply->type == REDIS_REPLY_NIL) {
+        return false;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+int64_t RedisReplyConverter::Integer(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        return reply->integer;
+    } else if (reply->type == REDIS_REPLY_NIL) {
+        return -1;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+std::optional<int64_t> RedisReplyConverter::OptionalInteger(const redisReply* reply, const char* command) {
+    if (!reply) {
+        return std::nullopt;
+    }
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_INTEGER) {
+        return reply->integer;
+    } else if (reply->type == REDIS_REPLY_NIL) {
+        return std::nullopt;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+double RedisReplyConverter::Double(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_STRING || reply->type == REDIS_REPLY_DOUBLE) {
+        return std::stod(std::string(reply->str, reply->len));
+    } else if (reply->type == REDIS_REPLY_INTEGER) {
+        return (double)reply->integer;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+std::optional<std::string> RedisReplyConverter::OptionalString(const redisReply* reply, const char* command) {
+    if (!reply) {
+        return std::nullopt;
+    }
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_STRING || reply->type == REDIS_REPLY_STATUS) {
+        return std::string(reply->str, reply->len);
+    } else if (reply->type == REDIS_REPLY_NIL) {
+        return std::nullopt;
+    }
+    throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+}
+std::optional<double> RedisReplyConverter::OptionalDouble(const redisReply* reply, const char* command) {
+    if (!reply) {
+        return std::nullopt;
+    }
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_NIL) {
+        return std::nullopt;
+    }
+    return Double(reply, command);
+}
+std::vector<std::string> RedisReplyConverter::StringArray(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_NIL) {
+        return {};
+    } else if (reply->type != REDIS_REPLY_ARRAY && reply->type != REDIS_REPLY_SET) {
+        throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+    }
+    std::vector<std::string> values;
+    values.reserve(reply->elements);
+    for (size_t i = 0; i < reply->elements; ++i) {
+        auto element = reply->element[i];
+        if (element->type != REDIS_REPLY_STRING) {
+            throw std::runtime_error(std::string("Unexpected element type within ") + command + " reply");
+        }
+        values.emplace_back(element->str, element->len);
+    }
+    return values;
+}
+std::vector<std::optional<std::string>> RedisReplyConverter::OptionalStringArray(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type != REDIS_REPLY_ARRAY) {
+        throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+    }
+    std::vector<std::optional<std::string>> values;
+    values.reserve(reply->elements);
+    for (size_t i = 0; i < reply->elements; ++i) {
+        auto element = reply->element[i];
+        if (element->type == REDIS_REPLY_STRING) {
+            values.emplace_back(std::string(element->str, element->len));
+        } else if (element->type == REDIS_REPLY_NIL) {
+            values.emplace_back(std::nullopt);
+        } else {
+            throw std::runtime_error(std::string("Unexpected element type within ") + command + " reply");
+        }
+    }
+    return values;
+}
+std::unordered_map<std::string, std::string> RedisReplyConverter::StringMap(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type != REDIS_REPLY_ARRAY && reply->type != REDIS_REPLY_MAP) {
+        throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+    }
+    std::unordered_map<std::string, std::string> values;
+    values.reserve(reply->elements / 2);
+    for (size_t i = 0; i + 1 < reply->elements; i += 2) {
+        auto field = reply->element[i];
+        auto value = reply->element[i + 1];
+        if (field->type != REDIS_REPLY_STRING || value->type != REDIS_REPLY_STRING) {
+            throw std::runtime_error(std::string("Invalid pair in ") + command + " reply");
+        }
+        values.emplace(std::string(field->str, field->len), std::string(value->str, value->len));
+    }
+    return values;
+}
+std::optional<std::pair<std::string, std::string>> RedisReplyConverter::OptionalStringPair(const redisReply* reply, const char* command) {
+    if (!reply) {
+        return std::nullopt;
+    }
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_NIL) {
+        return std::nullopt;
+    } else if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2
+        || reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_STRING) {
+        throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+    }
+    return std::make_pair(std::string(reply->element[0]->str, reply->element[0]->len)
+        , std::string(reply->element[1]->str, reply->element[1]->len));
+}
+std::vector<RedisStreamEntry> RedisReplyConverter::StreamEntries(const redisReply* reply, const char* command) {
+    CheckReply(reply, command);
+    if (reply->type == REDIS_REPLY_NIL) {
+        return {};
+    } else if (reply->type != REDIS_REPLY_ARRAY) {
+        throw std::runtime_error(std::string("Unexpected reply type when executing ") + command);
+    }
+    std::vector<RedisStreamEntry> entries(reply->elements);
+    for (size_t i = 0; i < reply->elements; ++i) {
+        auto entry = reply->element[i];
+        if (entry->type != REDIS_REPLY_ARRAY || entry->elements != 2 || entry->element[0]->type != REDIS_REPLY_STRING) {
+            throw std::runtime_error(std::string("Invalid entry in ") + command + " reply");
+        }
+        entries[i].id.assign(entry->element[0]->str, entry->element[0]->len);
+        /** a pending entry deleted from the stream comes back with a nil field list */
+        auto fields = entry->element[1];
+        if (fields->type != REDIS_REPLY_ARRAY) {
+            continue;
+        }
+        entries[i].fields.reserve(fields->elements / 2);
+        for (size_t j = 0; j + 1 < fields->elements; j += 2) {
+            auto field = fields->element[j];
+            auto value = fields->element[j + 1];
+            entries[i].fields.emplace_back(std::string(field->str, field->len), std::string(value->str, value->len));
+        }
+    }
+    return entries;
+}
+static std::string_view FormatArgument(char* buffer, int64_t value) {
+    auto [end, ec] = std::to_chars(buffer, buffer + 32, value);
+    return std::string_view(buffer, end - buffer);
+}
+static std::string_view FormatArgument(char* buffer, double value) {
+    auto [end, ec] = std::to_chars(buffer, buffer + 32, value);
+    return std::string_view(buffer, end - buffer);
+}
 RedisClient::Ptr RedisClient::Create(const std::string& ip
         , const uint16_t port, const std::string& password) {
     auto redisClient = std::make_shared<RedisClient>(ip, port, password);
@@ -13,7 +208,17 @@ RedisClient::RedisClient(const std::string& ip, const uint16_t port, const std::
     : m_host (ip), m_port (port), m_password (password), m_context (nullptr){
 }
 bool RedisClient::Reconnect() {
-    return redisReconnect(m_context.get());
+    if (!m_context || redisReconnect(m_context.get()) != REDIS_OK) {
+        return false;
+    }
+    /** hiredis creates a new reader on reconnect */
+    InstallArena();
+    RedisMetrics::CountReads(m_context.get());
+    m_trackingEpoch = 0;
+    if (!m_password.empty()) {
+        return Auth();
+    }
+    return true;
 }
 bool RedisClient::Connect() {
     return Connect(m_host, m_port, m_password);
@@ -32,26 +237,58 @@ bool RedisClient::ConnectWithTimeout(const std::string& ip, const uint16_t port,
     if (!client) {
         return false;
     }
+    if (client->err) {
+        redisFree(client);
+        return false;
+    }
     m_context.reset(client, redisFree);
+    InstallArena();
+    RedisMetrics::CountReads(m_context.get());
+    m_trackingEpoch = 0;
     if (!m_password.empty()) {
-        auto rt = Command("auth %s", m_password.c_str());
-        if (!rt) {
-            throw std::runtime_error("auth error:( " + m_host + " : " + std::to_string(m_port));
-        }
-        if (rt->type != REDIS_REPLY_STATUS) {
-            throw std::runtime_error("auth reply type error:( " + m_host + " : " + std::to_string(m_port));
-        }
-        if (!rt->str) {
-            throw std::runtime_error("auth reply str error:( " + m_host + " : " + std::to_string(m_port) + ", " + rt->str);
-        }
-        if (!strcmp("OK", rt->str)) {
-            return true;
-        } else {
-            throw std::runtime_error("auth error:( " + m_host + " : " + std::to_string(m_port));
-        }
+        return Auth();
     }
     return true;
 }
+bool RedisClient::Auth() {
+    auto rt = Command("auth %s", m_password.c_str());
+    if (!rt) {
+        throw std::runtime_error("auth error:( " + m_host + " : " + std::to_string(m_port));
+    }
+    if (rt->type != REDIS_REPLY_STATUS) {
+        throw std::runtime_error("auth reply type error:( " + m_host + " : " + std::to_string(m_port));
+    }
+    if (!rt->str) {
+        throw std::runtime_error("auth reply str error:( " + m_host + " : " + std::to_string(m_port) + ", " + rt->str);
+    }
+    if (!strcmp("OK", rt->str)) {
+        return true;
+    } else {
+        throw std::runtime_error("auth error:( " + m_host + " : " + std::to_string(m_port));
+    }
+}
+bool RedisClient::Ping() {
+    if (IsBroken()) {
+        return false;
+    }
+    auto reply = CommandArgv({"PING"});
+    return reply && reply->type == REDIS_REPLY_STATUS && reply->str && !strcmp("PONG", reply->str);
+}
+void RedisClient::EnableReplyArena(size_t blockSize) {
+    m_arena.reset(new RedisReplyArena(blockSize), [](RedisReplyArena* arena) { arena->Detach(); });
+    InstallArena();
+}
+void RedisClient::InstallArena() {
+    if (m_arena && m_context && m_context->reader) {
+        m_context->reader->fn = RedisReplyArena::Functions();
+        m_context->reader->privdata = m_arena.get();
+        /** pushes arriving under RESP3 are built by the arena too */
+        redisSetPushCallback(m_context.get(), &RedisReplyArena::FreePush);
+    }
+}
+RedisReplyPtr RedisClient::WrapReply(redisReply* reply) const {
+    return RedisReplyPtr(reply, RedisReplyDistory {m_arena ? &RedisReplyArena::FreeReply : &freeReplyObject});
+}
 void RedisClient::SetPassword(const std::string& password) {
     m_password = password;
 }
@@ -66,1235 +303,1487 @@ RedisReplyPtr RedisClient::Command(const char* fmt, ...) {
     return r;
 }
 RedisReplyPtr RedisClient::Command(const char* fmt, va_list ap) {
-    auto reply = (redisReply*)redisvCommand(m_context.get(), fmt, ap);
-    return std::unique_ptr<redisReply, RedisReplyDistory>(reply);
+    if (!RedisMetrics::Enabled()) {
+        auto reply = (redisReply*)redisvCommand(m_context.get(), fmt, ap);
+        return WrapReply(reply);
+    }
+    /** what redisvCommand does, with the formatted command kept for its name and size */
+    auto start = std::chrono::steady_clock::now();
+    auto bytesRead = RedisMetrics::BytesRead();
+    char* command = nullptr;
+    auto length = redisvFormatCommand(&command, fmt, ap);
+    if (length < 0) {
+        return WrapReply(nullptr);
+    }
+    redisReply* reply = nullptr;
+    if (redisAppendFormattedCommand(m_context.get(), command, length) == REDIS_OK) {
+        redisGetReply(m_context.get(), (void**)&reply);
+    }
+    auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    RedisMetrics::Record(RedisMetrics::CommandOf(command, length), nanos, length, RedisMetrics::BytesRead() - bytesRead, reply);
+    redisFreeCommand(command);
+    return WrapReply(reply);
+}
+RedisReplyPtr RedisClient::CommandArgv(const std::vector<std::string_view>& argv) {
+    m_argv.resize(argv.size());
+    m_argvlen.resize(argv.size());
+    for (size_t i = 0; i < argv.size(); ++i) {
+        m_argv[i] = argv[i].data();
+        m_argvlen[i] = argv[i].size();
+    }
+    auto measured = RedisMetrics::Enabled();
+    auto start = measured ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+    auto bytesRead = measured ? RedisMetrics::BytesRead() : 0;
+    auto reply = (redisReply*)redisCommandArgv(m_context.get(), (int)argv.size(), m_argv.data(), m_argvlen.data());
+    if (measured && !argv.empty()) {
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        RedisMetrics::Record(argv[0], nanos, RedisMetrics::RequestBytes(argv), RedisMetrics::BytesRead() - bytesRead, reply);
+    }
+    return WrapReply(reply);
+}
+RedisReplyView RedisClient::CommandView(const std::vector<std::string_view>& argv) {
+    auto reply = CommandArgv(argv);
+    CheckReply(reply.get(), argv[0].data());
+    return RedisReplyView(std::move(reply));
+}
+RedisReplyView RedisClient::get_view(const std::string& key) {
+    m_args.assign({"GET", key});
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::mget_view(const std::vector<std::string>& keys) {
+    m_args.assign({"MGET"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::hgetall_view(const std::string& key) {
+    m_args.assign({"HGETALL", key});
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::hmget_view(const std::string& key, const std::vector<std::string>& fields) {
+    m_args.assign({"HMGET", key});
+    m_args.insert(m_args.end(), fields.begin(), fields.end());
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::lrange_view(const std::string& key, long long start, long long stop) {
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"LRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::smembers_view(const std::string& key) {
+    m_args.assign({"SMEMBERS", key});
+    return CommandView(m_args);
+}
+RedisReplyView RedisClient::zrange_view(const std::string& key, int start, int stop, bool withScores) {
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"ZRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
+    if (withScores) {
+        m_args.emplace_back("WITHSCORES");
+    }
+    return CommandView(m_args);
 }
 int32_t RedisClient::del(const std::string& key) {
-    auto reply = Command("DEL %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : del " + key
-            + ", error message : " + reply->str);
-    }
-    return reply->integer;
+    m_args.assign({"DEL", key});
+    return (int32_t)Execute(&RedisReplyConverter::Integer);
 }
 std::optional<std::string> RedisClient::dump(const std::string& key) {
-    RedisReplyPtr reply = Command("DUMP %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_NIL) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command : DUMP " + key
-                + ", error message : " + reply->str);
-        }
-        return {}; 
-    } else if (reply->type != REDIS_REPLY_STRING) {
-        throw std::runtime_error("Unexpected reply type when executing DUMP for key: " + key);
-    }
-    return std::string(reply->str, reply->len);
+    m_args.assign({"DUMP", key});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 bool RedisClient::exists(const std::string& key) {
-     auto reply = Command("EXISTS %s", key.c_str());
-     return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    m_args.assign({"EXISTS", key});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::expire(const std::string& key, const int64_t seconds) {
-    auto reply = Command("EXPIRE %s %lld", key.c_str(), seconds);
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    char number[32];
+    m_args.assign({"EXPIRE", key, FormatArgument(number, seconds)});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::expireat(const std::string& key, const int64_t unix_timestamp) {
-    auto reply = Command("EXPIREAT %s %lld", key.c_str(), unix_timestamp);
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    char number[32];
+    m_args.assign({"EXPIREAT", key, FormatArgument(number, unix_timestamp)});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::pexpire(const std::string& key, const int64_t milliseconds) {
-    auto reply = Command("PEXPIRE %s %lld", key.c_str(), milliseconds);
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    char number[32];
+    m_args.assign({"PEXPIRE", key, FormatArgument(number, milliseconds)});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::pexpireat(const std::string& key, const int64_t milliseconds_timestamp) {
-    auto reply = Command("PEXPIREAT %s %lld", key.c_str(), milliseconds_timestamp);
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    char number[32];
+    m_args.assign({"PEXPIREAT", key, FormatArgument(number, milliseconds_timestamp)});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 std::vector<std::string> RedisClient::keys(const std::string& pattern) {
-    auto reply = Command("KEYS %s", pattern.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : keys " + pattern
-            + ", error message : " + reply->str);
-    }
-    std::vector<std::string> keys;
-    for (size_t i = 0; i < reply->elements; ++i) {
-        keys.push_back(reply->element[i]->str);
-    }
-    return keys;
+    m_args.assign({"KEYS", pattern});
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::move(const std::string& key, const int32_t destination_database) {
-    auto reply = Command("MOVE %s %d", key.c_str(), destination_database);
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    char number[32];
+    m_args.assign({"MOVE", key, FormatArgument(number, (int64_t)destination_database)});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::persist(const std::string& key) {
-    auto reply = Command("PERSIST %s", key.c_str());
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    m_args.assign({"PERSIST", key});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 int32_t RedisClient::pttl(const std::string& key) {
-    auto reply = Command("PTTL %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : pttl " + key
-            + ", error message : " + reply->str);
-    }
-    return reply->integer;
+    m_args.assign({"PTTL", key});
+    return (int32_t)Execute(&RedisReplyConverter::Integer);
 }
 int32_t RedisClient::ttl(const std::string& key) {
-    auto reply = Command("TTL %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : ttl " + key
-            + ", error message : " + reply->str);
-    }
-    return reply->integer;
+    m_args.assign({"TTL", key});
+    return (int32_t)Execute(&RedisReplyConverter::Integer);
 }
 std::optional<std::string> RedisClient::randonkey() {
-    auto reply = Command("RANDOMKEY");
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        return {};
-    }
-    return std::optional<std::string>(reply->str);
+    m_args.assign({"RANDOMKEY"});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 bool RedisClient::rename(const std::string& old_key, const std::string& new_key) {
-    auto reply = Command("RENAME %s %s", old_key.c_str(), new_key.c_str());
-    return reply && !reply->type == REDIS_REPLY_ERROR;
+    m_args.assign({"RENAME", old_key, new_key});
+    return Execute(&RedisReplyConverter::Status);
 }
 bool RedisClient::renamenx(const std::string& old_key, const std::string& new_key) {
-    auto reply = Command("RENAMENX %s %s", old_key.c_str(), new_key.c_str());
-    return reply && !reply->type == REDIS_REPLY_ERROR && reply->integer;
+    m_args.assign({"RENAMENX", old_key, new_key});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 RedisDataType RedisClient::type(const std::string& key) {
-    auto reply = Command("TYPE %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : type " + key
-            + ", error message : " + reply->str);
-    }
-    if (!strcmp(reply->str, "none")) return RedisDataType::none;
-    if (!strcmp(reply->str, "string")) return RedisDataType::string;
-    if (!strcmp(reply->str, "list")) return RedisDataType::list;
-    if (!strcmp(reply->str, "set")) return RedisDataType::set;
-    if (!strcmp(reply->str, "zset")) return RedisDataType::zset;
-    if (!strcmp(reply->str, "hash")) return RedisDataType::hash;
+    m_args.assign({"TYPE", key});
+    /** TYPE answers "none" for a missing key, no reply at all is a lost connection */
+    auto type = Execute(&RedisReplyConverter::OptionalString);
+    if (!type) {
+        throw std::runtime_error("redis error, command : type " + key + ", error message : connection lost");
+    }
+    if (*type == "none") return RedisDataType::none;
+    if (*type == "string") return RedisDataType::string;
+    if (*type == "list") return RedisDataType::list;
+    if (*type == "set") return RedisDataType::set;
+    if (*type == "zset") return RedisDataType::zset;
+    if (*type == "hash") return RedisDataType::hash;
     throw std::runtime_error("redis error, command : type " + key
-            + ", error message : invalid type (" + reply->str + ")");
+            + ", error message : invalid type (" + *type + ")");
 }
 bool RedisClient::set(const std::string& key, const std::string& value) {
-    auto reply = Command("SET %s %s", key.c_str(), value.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        throw std::runtime_error("redis error, command : SET " + key + " " + value
-            + ", error message : " + reply->str);
-    }
-    if (reply->type == REDIS_REPLY_STATUS && strcmp(reply->str, "OK") == 0) {
-        return true;
-    } else if (reply->type == REDIS_REPLY_NIL) {
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing SET for key: " + key);
-    }
+    m_args.assign({"SET", key, value});
+    return Execute(&RedisReplyConverter::Status);
 }
 std::optional<std::string> RedisClient::get(const std::string& key) {
-    auto reply = Command("GET %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("redis error, command : GET " + key
-                + ", error message : " + reply->str);
-        }
-        return {};
-    }
-    if (reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else if (reply->type == REDIS_REPLY_NIL) {
-        return {};
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing GET for key: " + key);
-    }
+    m_args.assign({"GET", key});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 std::optional<std::string> RedisClient::getrange(const std::string& key, int32_t start, int32_t end) {
-    auto reply = Command("GETRANGE %s %d %d", key.c_str(), start, end);
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command : GETRANGE " + key + " " + std::to_string(start) 
-                + " " + std::to_string(end) + ", error message : " + reply->str);
-        }
-        return {};
-    }
-    if (reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing GETRANGE for key: " + key);
-    }
+    char startNumber[32], endNumber[32];
+    m_args.assign({"GETRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(endNumber, (int64_t)end)});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 std::optional<std::string> RedisClient::getset(const std::string& key, const std::string& value) {
-    auto reply = Command("GETSET %s %s", key.c_str(), value.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: GETSET " + key + " " + value 
-                + ", error message: " + reply->str);
-        }
-        return {}; 
-    }
-    if (reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing GETSET for key: " + key);
-    }
+    m_args.assign({"GETSET", key, value});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 std::optional<int32_t> RedisClient::getbit(const std::string& key, int32_t offset) {
-    auto reply = Command("GETBIT %s %d", key.c_str(), offset);
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: GETBIT " + key + " " + std::to_string(offset) 
-                + ", error message: " + reply->str);
-        }
-        return {};
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing GETBIT for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"GETBIT", key, FormatArgument(number, (int64_t)offset)});
+    auto bit = Execute(&RedisReplyConverter::OptionalInteger);
+    return bit ? std::optional<int32_t>((int32_t)*bit) : std::nullopt;
 }
 std::vector<std::optional<std::string>> RedisClient::mget(const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "MGET";
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: MGET " + cmd.str() 
-                + ", error message: " + reply->str);
-        } else {
-            throw std::runtime_error("Unexpected reply type when executing MGET");
-        }
-    }
-    std::vector<std::optional<std::string>> values;
-    for (size_t i = 0; i < reply->elements; ++i) {
-        auto element = reply->element[i];
-        if (element->type == REDIS_REPLY_STRING) {
-            values.push_back(std::string(element->str, element->len));
-        } else if (element->type == REDIS_REPLY_NIL) {
-            values.push_back(std::nullopt);
-        } else {
-            throw std::runtime_error("Unexpected element type within MGET reply");
-        }
-    }
-    return values;
+    m_args.assign({"MGET"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::OptionalStringArray);
 }
 bool RedisClient::setbit(const std::string& key, int32_t offset, int32_t bit) {
-    auto reply = Command("SETBIT %s %d %d", key.c_str(), offset, bit);
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: SETBIT " + key + " " + std::to_string(offset) 
-                + " " + std::to_string(bit) + ", error message: " + reply->str);
-        }
-        return false;
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing SETBIT for key: " + key);
-    }
+    char offsetNumber[32], bitNumber[32];
+    m_args.assign({"SETBIT", key, FormatArgument(offsetNumber, (int64_t)offset), FormatArgument(bitNumber, (int64_t)bit)});
+    Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 bool RedisClient::setex(const std::string& key, int32_t seconds, const std::string& value) {
-    auto reply = Command("SETEX %s %d %s", key.c_str(), seconds, value.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: SETEX " + key + " " + std::to_string(seconds) 
-                + " " + value + ", error message: " + reply->str);
-        }
-        return false;
-    }
-    if (reply->type == REDIS_REPLY_STATUS && strcmp(reply->str, "OK") == 0) {
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply type or content when executing SETEX for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"SETEX", key, FormatArgument(number, (int64_t)seconds), value});
+    return Execute(&RedisReplyConverter::Status);
 }
 bool RedisClient::setnx(const std::string& key, const std::string& value) {
-    auto reply = Command("SETNX %s %s", key.c_str(), value.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: SETNX " + key + " " + value 
-                + ", error message: " + reply->str);
-        }
-        return false;
-    }
-    if (reply->type == REDIS_REPLY_INTEGER && reply->integer == 1) {
-        return true; 
-    } else if (reply->integer == 0) {
-        return false;
-    } else {
-        throw std::runtime_error("Unexpected reply type or content when executing SETNX for key: " + key);
-    }
+    m_args.assign({"SETNX", key, value});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::setrange(const std::string& key, int32_t offset, const std::string& value) {
-    auto reply = Command("SETRANGE %s %d %s", key.c_str(), offset, value.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: SETRANGE " + key + " " + std::to_string(offset) 
-                + " " + value + ", error message: " + reply->str);
-        }
-        return false;
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing SETRANGE for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"SETRANGE", key, FormatArgument(number, (int64_t)offset), value});
+    Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 std::optional<int32_t> RedisClient::strlen(const std::string& key) {
-    auto reply = Command("STRLEN %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: STRLEN " + key 
-                + ", error message: " + reply->str);
-        }
-        return {};
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing STRLEN for key: " + key);
-    }
+    m_args.assign({"STRLEN", key});
+    auto length = Execute(&RedisReplyConverter::OptionalInteger);
+    return length ? std::optional<int32_t>((int32_t)*length) : std::nullopt;
 }
 bool RedisClient::mset(const std::vector<std::pair<std::string, std::string>>& values) {
-    std::stringstream cmd;
-    cmd << "MSET";
+    m_args.assign({"MSET"});
     for (const auto& pair : values) {
-        cmd << " " << pair.first << " " << pair.second;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type != REDIS_REPLY_STATUS || strcmp(reply->str, "OK")) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: MSET " + cmd.str() 
-                + ", error message: " + reply->str);
-        } else {
-            throw std::runtime_error("Unexpected reply or failed to execute MSET");
-        }
+        m_args.emplace_back(pair.first);
+        m_args.emplace_back(pair.second);
     }
-    return true;
+    return Execute(&RedisReplyConverter::Status);
 }
 int64_t RedisClient::incr(const std::string& key) {
-    auto reply = Command("INCR %s", key.c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: INCR " + key 
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to increment key without specific error message");
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing INCR for key: " + key);
-    }
+    m_args.assign({"INCR", key});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::incrby(const std::string& key, int64_t increment) {
-    std::stringstream cmd;
-    cmd << "INCRBY " << key << " " << increment;
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: INCRBY " + key + " " + std::to_string(increment) 
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to increment key by specified amount without specific error message");
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing INCRBY for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"INCRBY", key, FormatArgument(number, increment)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 double RedisClient::incrbyfloat(const std::string& key, double increment) {
-    std::stringstream cmd;
-    cmd << "INCRBYFLOAT " << key << " " << increment;
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: INCRBYFLOAT " + key + " " + std::to_string(increment)
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to increment key by float value without specific error message");
-    }
-    return std::stod(reply->str);
+    char number[32];
+    m_args.assign({"INCRBYFLOAT", key, FormatArgument(number, increment)});
+    return Execute(&RedisReplyConverter::Double);
 }
 int64_t RedisClient::decr(const std::string& key) {
-    std::stringstream cmd;
-    cmd << "DECR " << key;
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: DECR " + key 
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to decrement key without specific error message");
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing DECR for key: " + key);
-    }
+    m_args.assign({"DECR", key});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::decrby(const std::string& key, int64_t decrement) {
-    std::stringstream cmd;
-    cmd << "DECRBY " << key << " " << decrement;
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: DECRBY " + key + " " + std::to_string(decrement) 
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to decrement key by specified amount without specific error message");
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing DECRBY for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"DECRBY", key, FormatArgument(number, decrement)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::append(const std::string& key, const std::string& value) {
-    std::stringstream cmd;
-    cmd << "APPEND " << key << " " << value;
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type == REDIS_REPLY_ERROR) {
-        if (reply && reply->type == REDIS_REPLY_ERROR) {
-            throw std::runtime_error("Redis error, command: APPEND " + key + " " + value 
-                + ", error message: " + reply->str);
-        }
-        throw std::runtime_error("Failed to append value to key without specific error message");
-    }
-    if (reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing APPEND for key: " + key);
-    }
+    m_args.assign({"APPEND", key, value});
+    return Execute(&RedisReplyConverter::Integer);
 }
 bool RedisClient::hdel(const std::string& key, const std::vector<std::string>& fields) {
-    std::stringstream cmd;
-    cmd << "HDEL " << key;
-    for (const auto& field : fields) {
-        cmd << " " << field;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    return reply && reply->type == REDIS_REPLY_INTEGER && reply->integer > 0;
+    m_args.assign({"HDEL", key});
+    m_args.insert(m_args.end(), fields.begin(), fields.end());
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::hexists(const std::string& key, const std::string& field) {
-    auto reply = Command("HEXISTS %s %s", key.c_str(), field.c_str());
-    return reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1;
+    m_args.assign({"HEXISTS", key, field});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 std::optional<std::string> RedisClient::hget(const std::string& key, const std::string& field) {
-    auto reply = Command("HGET %s %s", key.c_str(), field.c_str());
-    if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt; 
-    }
-    throw std::runtime_error("Unexpected reply type when executing HGET for key: " + key);
+    m_args.assign({"HGET", key, field});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 std::unordered_map<std::string, std::string> RedisClient::hgetall(const std::string& key) {
-    std::unordered_map<std::string, std::string> result;
-    auto reply = Command("HGETALL %s", key.c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        throw std::runtime_error("Unexpected reply when executing HGETALL for key: " + key);
-    }
-    for (size_t i = 0; i < reply->elements; i += 2) {
-        auto fieldReply = reply->element[i];
-        auto valueReply = reply->element[i + 1];
-        if (fieldReply->type == REDIS_REPLY_STRING && valueReply->type == REDIS_REPLY_STRING) {
-            result[fieldReply->str] = std::string(valueReply->str, valueReply->len);
-        } else {
-            throw std::runtime_error("Invalid pair in HGETALL reply for key: " + key);
-        }
-    }
-    return result;
+    m_args.assign({"HGETALL", key});
+    return Execute(&RedisReplyConverter::StringMap);
 }
 int64_t RedisClient::hincrby(const std::string& key, const std::string& field, int64_t increment) {
-    auto reply = Command("HINCRBY %s %s %lld", key.c_str(), field.c_str(), increment);
-    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
-        throw std::runtime_error("Unexpected reply when executing HINCRBY for key: " + key);
-    }
-    return reply->integer;
+    char number[32];
+    m_args.assign({"HINCRBY", key, field, FormatArgument(number, increment)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 double RedisClient::hicrbyfloat(const std::string& key, const std::string& field, double increment) {
-    auto reply = Command("HINCRBYFLOAT %s %s %f", key.c_str(), field.c_str(), increment);
-    if (!reply || reply->type != REDIS_REPLY_STRING) {
-        throw std::runtime_error("Unexpected reply when executing HINCRBYFLOAT for key: " + key);
-    }
-    return std::stod(reply->str);
+    char number[32];
+    m_args.assign({"HINCRBYFLOAT", key, field, FormatArgument(number, increment)});
+    return Execute(&RedisReplyConverter::Double);
 }
 std::vector<std::string> RedisClient::hkeys(const std::string& key) {
-    std::vector<std::string> keys;
-    auto reply = Command("HKEYS %s", key.c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        throw std::runtime_error("Unexpected reply when executing HKEYS for key: " + key);
-    }
-    for (size_t i = 0; i < reply->elements; ++i) {
-        auto fieldReply = reply->element[i];
-        if (fieldReply->type == REDIS_REPLY_STRING) {
-            keys.push_back(std::string(fieldReply->str, fieldReply->len));
-        } else {
-            throw std::runtime_error("Invalid entry in HKEYS reply for key: " + key);
-        }
-    }
-    return keys;
+    m_args.assign({"HKEYS", key});
+    return Execute(&RedisReplyConverter::StringArray);
 }
 int64_t RedisClient::hlen(const std::string& key) {
-    auto reply = Command("HLEN %s", key.c_str());
-    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
-        throw std::runtime_error("Unexpected reply when executing HLEN for key: " + key);
-    }
-    return reply->integer;
+    m_args.assign({"HLEN", key});
+    return Execute(&RedisReplyConverter::Integer);
 }
 std::vector<std::optional<std::string>> RedisClient::hmget(const std::string& key, const std::vector<std::string>& fields) {
-    std::stringstream cmd;
-    cmd << "HMGET " << key;
-    for (const auto& field : fields) {
-        cmd << " " << field;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        throw std::runtime_error("Unexpected reply when executing HMGET for key: " + key);
-    }
-    std::vector<std::optional<std::string>> values;
-    for (size_t i = 0; i < reply->elements; ++i) {
-        auto fieldReply = reply->element[i];
-        if (fieldReply->type == REDIS_REPLY_NIL) {
-            values.push_back(std::nullopt);
-        } else if (fieldReply->type == REDIS_REPLY_STRING) {
-            values.push_back(std::string(fieldReply->str, fieldReply->len));
-        } else {
-            throw std::runtime_error("Invalid entry in HMGET reply for key: " + key);
-        }
-    }
-    return values;
+    m_args.assign({"HMGET", key});
+    m_args.insert(m_args.end(), fields.begin(), fields.end());
+    return Execute(&RedisReplyConverter::OptionalStringArray);
 }
 bool RedisClient::hmset(const std::string& key, const std::unordered_map<std::string, std::string>& values) {
-    std::stringstream cmd;
-    cmd << "HMSET " << key;
+    m_args.assign({"HMSET", key});
     for (const auto& pair : values) {
-        cmd << " " << pair.first << " " << pair.second;
+        m_args.emplace_back(pair.first);
+        m_args.emplace_back(pair.second);
     }
-    
-    auto reply = Command(cmd.str().c_str());
-    return reply && reply->type == REDIS_REPLY_STRING && strcmp(reply->str, "OK") == 0;
+    return Execute(&RedisReplyConverter::Status);
 }
 bool RedisClient::hset(const std::string& key, const std::string& field, const std::string& value) {
-    auto reply = Command("HSET %s %s %s", key.c_str(), field.c_str(), value.c_str());
-    return reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1;
+    m_args.assign({"HSET", key, field, value});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::hsetnx(const std::string& key, const std::string& field, const std::string& value) {
-    auto reply = Command("HSETNX %s %s %s %s", key.c_str(), field.c_str(), value.c_str());
-    return reply && reply->type == REDIS_REPLY_INTEGER && reply->integer == 1;
+    m_args.assign({"HSETNX", key, field, value});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 std::vector<std::string> RedisClient::hvals(const std::string& key) {
-    std::vector<std::string> values;
-    auto reply = Command("HVALS %s", key.c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        throw std::runtime_error("Unexpected reply when executing HVALS for key: " + key);
-    }
-    for (size_t i = 0; i < reply->elements; ++i) {
-        auto valueReply = reply->element[i];
-        if (valueReply->type == REDIS_REPLY_STRING) {
-            values.push_back(std::string(valueReply->str, valueReply->len));
-        } else {
-            throw std::runtime_error("Invalid entry in HVALS reply for key: " + key);
-        }
-    }
-    return values;
+    m_args.assign({"HVALS", key});
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::sadd(const std::string& key, const std::vector<std::string>& members, int& addedCount) {
-    std::stringstream cmd;
-    cmd << "SADD " << key;
-    for (const auto& member : members) {
-        cmd << " " << member;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        addedCount = reply->integer;
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SADD for key: " + key);
-    }
+    m_args.assign({"SADD", key});
+    m_args.insert(m_args.end(), members.begin(), members.end());
+    addedCount = (int)Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 int64_t RedisClient::scard(const std::string& key) {
-    auto reply = Command("SCARD %s", key.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SCARD for key: " + key);
-    }
+    m_args.assign({"SCARD", key});
+    return Execute(&RedisReplyConverter::Integer);
 }
 std::vector<std::string> RedisClient::sdiff(const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SDIFF";
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> diffSet;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                diffSet.push_back(std::string(elem->str, elem->len));
-            } else {
-                throw std::runtime_error("Invalid entry in SDIFF reply");
-            }
-        }
-        return diffSet;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SDIFF for keys");
-    }
+    m_args.assign({"SDIFF"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::sdiffstore(const std::string& destination, const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SDIFFSTORE " << destination;
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    return reply && reply->type == REDIS_REPLY_INTEGER && reply->integer >= 0;
+    m_args.assign({"SDIFFSTORE", destination});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::Integer) >= 0;
 }
 std::vector<std::string> RedisClient::sinter(const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SINTER";
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> intersection;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                intersection.push_back(std::string(elem->str, elem->len));
-            } else {
-                throw std::runtime_error("Invalid entry in SINTER reply");
-            }
-        }
-        return intersection;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SINTER for keys");
-    }
+    m_args.assign({"SINTER"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::sinterstore(const std::string& destination, const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SINTERSTORE " << destination;
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer >= 0;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SINTERSTORE for destination: " + destination);
-    }
+    m_args.assign({"SINTERSTORE", destination});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::Integer) >= 0;
 }
 std::vector<std::string> RedisClient::smembers(const std::string& key) {
-    auto reply = Command("SMEMBERS %s", key.c_str());
-    if (!reply || reply->type != REDIS_REPLY_ARRAY) {
-        throw std::runtime_error("Unexpected reply when executing SMEMBERS for key: " + key);
-    }
-    
-    std::vector<std::string> members;
-    for (size_t i = 0; i < reply->elements; ++i) {
-        auto elem = reply->element[i];
-        if (elem->type == REDIS_REPLY_STRING) {
-            members.push_back(std::string(elem->str, elem->len));
-        } else {
-            throw std::runtime_error("Invalid entry in SMEMBERS reply for key: " + key);
-        }
-    }
-    return members;
+    m_args.assign({"SMEMBERS", key});
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::smove(const std::string& source, const std::string& destination, const std::string& member) {
-    auto reply = Command("SMOVE %s %s %s", source.c_str(), destination.c_str(), member.c_str());
-    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
-        throw std::runtime_error("Unexpected reply when executing SMOVE from " + source + " to " + destination);
-    }
-    
-    return reply->integer == 1;
+    m_args.assign({"SMOVE", source, destination, member});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 bool RedisClient::sismember(const std::string& key, const std::string& member) {
-    auto reply = Command("SISMEMBER %s %s", key.c_str(), member.c_str());
-    if (!reply || reply->type != REDIS_REPLY_INTEGER) {
-        throw std::runtime_error("Unexpected reply when executing SISMEMBER for key: " + key);
-    }
-    return reply->integer == 1;
+    m_args.assign({"SISMEMBER", key, member});
+    return Execute(&RedisReplyConverter::Boolean);
 }
 std::optional<std::string> RedisClient::spop(const std::string& key) {
-    auto reply = Command("SPOP %s", key.c_str());
-    if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt;
-    } else if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SPOP for key: " + key);
-    }
+    m_args.assign({"SPOP", key});
+    return Execute(&RedisReplyConverter::OptionalString);
 }
 std::vector<std::string> RedisClient::srandmember(const std::string& key, size_t count) {
-    std::stringstream cmd;
-    cmd << "SRANDMEMBER " << key << " " << count;
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> randomMembers;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                randomMembers.push_back(std::string(elem->str, elem->len));
-            } else {
-                throw std::runtime_error("Invalid entry in SRANDMEMBER reply");
-            }
-        }
-        return randomMembers;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SRANDMEMBER for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"SRANDMEMBER", key, FormatArgument(number, (int64_t)count)});
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::srem(const std::string& key, const std::vector<std::string>& members, int& removedCount) {
-    std::stringstream cmd;
-    cmd << "SREM " << key;
-    for (const auto& member : members) {
-        cmd << " " << member;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        removedCount = reply->integer;
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SREM for key: " + key);
-    }
+    m_args.assign({"SREM", key});
+    m_args.insert(m_args.end(), members.begin(), members.end());
+    removedCount = (int)Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 std::vector<std::string> RedisClient::sunion(const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SUNION";
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> unionSet;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                unionSet.push_back(std::string(elem->str, elem->len));
-            } else {
-                throw std::runtime_error("Invalid entry in SUNION reply");
-            }
-        }
-        return unionSet;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SUNION for keys");
-    }
+    m_args.assign({"SUNION"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::StringArray);
 }
 bool RedisClient::sunionstore(const std::string& destination, const std::vector<std::string>& keys) {
-    std::stringstream cmd;
-    cmd << "SUNIONSTORE " << destination;
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer >= 0;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing SUNIONSTORE for destination: " + destination);
-    }
+    m_args.assign({"SUNIONSTORE", destination});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    return Execute(&RedisReplyConverter::Integer) >= 0;
 }
 bool RedisClient::zadd(const std::string& key, const std::vector<std::pair<std::string, double>>& membersWithScores, int& addedCount) {
-    std::stringstream cmd;
-    cmd << "ZADD " << key;
-    for (const auto& pair : membersWithScores) {
-        cmd << " " << pair.second << " " << pair.first;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        addedCount = reply->integer;
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZADD for key: " + key);
+    m_numbers.resize(membersWithScores.size());
+    m_args.assign({"ZADD", key});
+    for (size_t i = 0; i < membersWithScores.size(); ++i) {
+        m_args.emplace_back(FormatArgument(m_numbers[i].data(), membersWithScores[i].second));
+        m_args.emplace_back(membersWithScores[i].first);
     }
+    addedCount = (int)Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 int64_t RedisClient::zcard(const std::string& key) {
-    auto reply = Command("ZCARD %s", key.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZCARD for key: " + key);
-    }
+    m_args.assign({"ZCARD", key});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::zcount(const std::string& key, double minScore, double maxScore) {
-    auto reply = Command("ZCOUNT %s %f %f", key.c_str(), minScore, maxScore);
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZCOUNT for key: " + key);
-    }
+    char minNumber[32], maxNumber[32];
+    m_args.assign({"ZCOUNT", key, FormatArgument(minNumber, minScore), FormatArgument(maxNumber, maxScore)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 double RedisClient::zincrby(const std::string& key, double increment, const std::string& member) {
-    auto reply = Command("ZINCRBY %s %f %s", key.c_str(), increment, member.c_str());
-    if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::stod(reply->str);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZINCRBY for key: " + key);
-    }
+    char number[32];
+    m_args.assign({"ZINCRBY", key, FormatArgument(number, increment), member});
+    return Execute(&RedisReplyConverter::Double);
 }
 bool RedisClient::zinterstore(const std::string& destination, const std::vector<std::string>& keys, const std::vector<std::string>& weights /* optional */, bool aggregateSum /* default */, int64_t& count) {
-    std::stringstream cmd;
-    cmd << "ZINTERSTORE " << destination << " " << keys.size();
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
+    char number[32];
+    m_args.assign({"ZINTERSTORE", destination, FormatArgument(number, (int64_t)keys.size())});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
     if (!weights.empty()) {
-        cmd << " WEIGHTS";
-        for (const auto& weight : weights) {
-            cmd << " " << weight;
-        }
-    }
-    cmd << " " << (aggregateSum ? "SUM" : "AGGREGATE");
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        count = reply->integer;
-        return true;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZINTERSTORE for destination: " + destination);
+        m_args.emplace_back("WEIGHTS");
+        m_args.insert(m_args.end(), weights.begin(), weights.end());
     }
+    m_args.emplace_back(aggregateSum ? "SUM" : "AGGREGATE");
+    count = Execute(&RedisReplyConverter::Integer);
+    return true;
 }
 int64_t RedisClient::zlexcount(const std::string& key, const std::string& minMember, const std::string& maxMember) {
-    auto reply = Command("ZLEXCOUNT %s %s %s", key.c_str(), minMember.c_str(), maxMember.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZLEXCOUNT for key: " + key);
-    }
+    m_args.assign({"ZLEXCOUNT", key, minMember, maxMember});
+    return Execute(&RedisReplyConverter::Integer);
 }
 std::vector<std::string> RedisClient::zrange(const std::string& key, int start, int stop, bool withScores) {
-    std::stringstream cmd;
-    cmd << "ZRANGE " << key << " " << start << " " << stop;
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"ZRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
     if (withScores) {
-        cmd << " WITHSCORES";
-    }
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> members;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                members.push_back(std::string(elem->str, elem->len));
-            } else if (withScores && elem->type == REDIS_REPLY_STRING) { 
-                members.push_back(elem->str); 
-            } else {
-                throw std::runtime_error("Invalid entry in ZRANGE reply");
-            }
-        }
-        return members;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZRANGE for key: " + key);
+        m_args.emplace_back("WITHSCORES");
     }
+    return Execute(&RedisReplyConverter::StringArray);
 }
 std::vector<std::string> RedisClient::zrangebylex(const std::string& key, const std::string& minLex, const std::string& maxLex, bool withScores, long long offset, long long count) {
-    std::stringstream cmd;
-    cmd << "ZRANGEBYLEX " << key << " " << minLex << " " << maxLex;
+    char offsetNumber[32], countNumber[32];
+    m_args.assign({"ZRANGEBYLEX", key, minLex, maxLex});
     if (withScores) {
-        cmd << " WITHSCORES";
+        m_args.emplace_back("WITHSCORES");
     }
     if (offset > 0 || count > 0) {
-        cmd << " LIMIT " << offset << " " << count;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> results;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                results.push_back(std::string(elem->str, elem->len));
-            } else if (withScores && elem->type == REDIS_REPLY_STRING) {
-                results.push_back(elem->str); 
-            } else {
-                throw std::runtime_error("Unexpected element type in ZRANGEBYLEX reply.");
-            }
-        }
-        return results;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZRANGEBYLEX for key: " + key);
+        m_args.insert(m_args.end(), {"LIMIT", FormatArgument(offsetNumber, (int64_t)offset), FormatArgument(countNumber, (int64_t)count)});
     }
+    return Execute(&RedisReplyConverter::StringArray);
 }
 std::vector<std::string> RedisClient::zrangebyscore(const std::string& key, double minScore, double maxScore, bool withScores, bool reverse, long long limitOffset, long long limitCount) {
-    std::stringstream cmd;
-    cmd << "ZRANGEBYSCORE " << key << " " << minScore << " " << maxScore;
+    char minNumber[32], maxNumber[32], offsetNumber[32], countNumber[32];
+    m_args.assign({"ZRANGEBYSCORE", key, FormatArgument(minNumber, minScore), FormatArgument(maxNumber, maxScore)});
     if (withScores) {
-        cmd << " WITHSCORES";
+        m_args.emplace_back("WITHSCORES");
     }
     if (reverse) {
-        cmd << " REV";
+        m_args.emplace_back("REV");
     }
     if (limitOffset >= 0 && limitCount > 0) {
-        cmd << " LIMIT " << limitOffset << " " << limitCount;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> results;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                results.push_back(std::string(elem->str, elem->len));
-            } else if (withScores && elem->type == REDIS_REPLY_STRING) {
-                results.push_back(elem->str);
-            } else {
-                throw std::runtime_error("Unexpected element type in ZRANGEBYSCORE reply.");
-            }
-        }
-        return results;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZRANGEBYSCORE for key: " + key);
+        m_args.insert(m_args.end(), {"LIMIT", FormatArgument(offsetNumber, (int64_t)limitOffset), FormatArgument(countNumber, (int64_t)limitCount)});
     }
+    return Execute(&RedisReplyConverter::StringArray);
 }
 int64_t RedisClient::zrank(const std::string& key, const std::string& member) {
-    auto reply = Command("ZRANK %s %s", key.c_str(), member.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else if (reply->type == REDIS_REPLY_NIL) {
-        return -1;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZRANK for key: " + key);
-    }
+    /** -1 for a missing member */
+    m_args.assign({"ZRANK", key, member});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::zremrangebylex(const std::string& key, const std::string& minLex, const std::string& maxLex) {
-    auto reply = Command("ZREMRANGEBYLEX %s %s %s", key.c_str(), minLex.c_str(), maxLex.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREMRANGEBYLEX for key: " + key);
-    }
+    m_args.assign({"ZREMRANGEBYLEX", key, minLex, maxLex});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::zremrangebyrank(const std::string& key, int start, int stop) {
-    std::stringstream cmd;
-    cmd << "ZREMRANGEBYRANK " << key << " " << start << " " << stop;
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer; 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREMRANGEBYRANK for key: " + key);
-    }
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"ZREMRANGEBYRANK", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 int64_t RedisClient::zremrangebyscore(const std::string& key, double minScore, double maxScore) {
-    std::stringstream cmd;
-    cmd << "ZREMRANGEBYSCORE " << key << " " << minScore << " " << maxScore;
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREMRANGEBYSCORE for key: " + key);
-    }
+    char minNumber[32], maxNumber[32];
+    m_args.assign({"ZREMRANGEBYSCORE", key, FormatArgument(minNumber, minScore), FormatArgument(maxNumber, maxScore)});
+    return Execute(&RedisReplyConverter::Integer);
 }
 std::vector<std::string> RedisClient::zrevrange(const std::string& key, int start, int stop, bool withscores) {
-    std::stringstream cmd;
-    cmd << "ZREVRANGE " << key << " " << start << " " << stop;
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"ZREVRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
     if (withscores) {
-        cmd << " WITHSCORES";
-    }
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> elements;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto element = reply->element[i];
-            if (element->type != REDIS_REPLY_STRING) {
-                throw std::runtime_error("Unexpected element type in ZREVRANGE reply.");
-            }
-            elements.push_back(std::string(element->str, element->len));
-        }
-        return elements;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREVRANGE for key: " + key);
+        m_args.emplace_back("WITHSCORES");
     }
+    return Execute(&RedisReplyConverter::StringArray);
 }
 std::vector<std::string> RedisClient::zrevrangebyscore(const std::string& key, double maxScore, double minScore, bool withScores, int offset, int count) {
-    std::stringstream cmd;
-    cmd << "ZREVRANGEBYSCORE " << key << " " << maxScore << " " << minScore;
+    char maxNumber[32], minNumber[32], offsetNumber[32], countNumber[32];
+    m_args.assign({"ZREVRANGEBYSCORE", key, FormatArgument(maxNumber, maxScore), FormatArgument(minNumber, minScore)});
     if (withScores) {
-        cmd << " WITHSCORES";
+        m_args.emplace_back("WITHSCORES");
     }
     if (offset > 0) {
-        cmd << " OFFSET " << offset;
+        m_args.insert(m_args.end(), {"OFFSET", FormatArgument(offsetNumber, (int64_t)offset)});
     }
     if (count > 0) {
-        cmd << " COUNT " << count;
-    }
-    
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> results;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            auto elem = reply->element[i];
-            if (elem->type == REDIS_REPLY_STRING) {
-                results.push_back(std::string(elem->str, elem->len));
-            } else if (withScores && elem->type == REDIS_REPLY_STRING) {
-                results.push_back(elem->str);
-            } else {
-                throw std::runtime_error("Unexpected element type in ZREVRANGEBYSCORE reply.");
-            }
-        }
-        return results;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREVRANGEBYSCORE for key: " + key);
+        m_args.insert(m_args.end(), {"COUNT", FormatArgument(countNumber, (int64_t)count)});
     }
+    return Execute(&RedisReplyConverter::StringArray);
 }
 int64_t RedisClient::zrevrank(const std::string& key, const std::string& member) {
-    auto reply = Command("ZREVRANK %s %s", key.c_str(), member.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else if (reply->type == REDIS_REPLY_NIL) {
-        return -1;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZREVRANK for key: " + key);
-    }
+    /** -1 for a missing member */
+    m_args.assign({"ZREVRANK", key, member});
+    return Execute(&RedisReplyConverter::Integer);
 }
 std::optional<double> RedisClient::zscore(const std::string& key, const std::string& member) {
-    auto reply = Command("ZSCORE %s %s", key.c_str(), member.c_str());
-    if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::stod(reply->str);
-    } else if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZSCORE for key: " + key);
-    }
+    m_args.assign({"ZSCORE", key, member});
+    return Execute(&RedisReplyConverter::OptionalDouble);
 }
 bool RedisClient::zunionstore(const std::string& destination, const std::vector<std::string>& keys, const std::vector<double>& weights /* = {} */, const std::string& aggregate /* = "SUM" */) {
-    std::stringstream cmd;
-    cmd << "ZUNIONSTORE " << destination << " " << keys.size();
-    for (const auto& key : keys) {
-        cmd << " " << key;
-    }
+    char number[32];
+    m_numbers.resize(weights.size());
+    m_args.assign({"ZUNIONSTORE", destination, FormatArgument(number, (int64_t)keys.size())});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
     if (!weights.empty()) {
-        cmd << " WEIGHTS";
-        for (const auto& weight : weights) {
-            cmd << " " << weight;
+        m_args.emplace_back("WEIGHTS");
+        for (size_t i = 0; i < weights.size(); ++i) {
+            m_args.emplace_back(FormatArgument(m_numbers[i].data(), weights[i]));
         }
     }
     if (!aggregate.empty() && aggregate != "SUM") {
-        cmd << " " << aggregate; 
-    }
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer >= 0;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing ZUNIONSTORE for destination: " + destination);
+        m_args.insert(m_args.end(), {"AGGREGATE", aggregate});
     }
+    return Execute(&RedisReplyConverter::Integer) >= 0;
 }
 std::pair<std::string, std::string> RedisClient::blpop(const std::vector<std::string>& keys, int timeout) {
-    std::stringstream cmd;
-    cmd << "BLPOP ";
-    for (size_t i = 0; i < keys.size(); ++i) {
-        cmd << keys[i] << (i < keys.size() - 1 ? " " : "");
+    char number[32];
+    m_args.assign({"BLPOP"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    m_args.emplace_back(FormatArgument(number, (int64_t)timeout));
+    if (auto popped = Execute(&RedisReplyConverter::OptionalStringPair)) {
+        return std::move(*popped);
+    }
+    throw std::runtime_error(std::string("redis error, command : BLPOP, error message : ") + (IsBroken() ? "connection lost" : "timeout"));
+}
+std::pair<std::string, std::string> RedisClient::brpop(const std::vector<std::string>& keys, int timeout) {
+    char number[32];
+    m_args.assign({"BRPOP"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    m_args.emplace_back(FormatArgument(number, (int64_t)timeout));
+    if (auto popped = Execute(&RedisReplyConverter::OptionalStringPair)) {
+        return std::move(*popped);
+    }
+    throw std::runtime_error(std::string("redis error, command : BRPOP, error message : ") + (IsBroken() ? "connection lost" : "timeout"));
+}
+std::string RedisClient::brpoplpush(const std::string& source, const std::string& destination, int timeout) {
+    char number[32];
+    m_args.assign({"BRPOPLPUSH", source, destination, FormatArgument(number, (int64_t)timeout)});
+    if (auto moved = Execute(&RedisReplyConverter::OptionalString)) {
+        return std::move(*moved);
+    }
+    throw std::runtime_error(std::string("redis error, command : BRPOPLPUSH, error message : ") + (IsBroken() ? "connection lost" : "timeout"));
+}
+std::optional<std::string> RedisClient::lindex(const std::string& key, long long index) {
+    char number[32];
+    m_args.assign({"LINDEX", key, FormatArgument(number, (int64_t)index)});
+    return Execute(&RedisReplyConverter::OptionalString);
+}
+bool RedisClient::linsert(const std::string& key, const std::string& pivot, const std::string& value, bool before) {
+    m_args.assign({"LINSERT", key, before ? "BEFORE" : "AFTER", pivot, value});
+    return Execute(&RedisReplyConverter::Integer) >= 0;
+}
+size_t RedisClient::llen(const std::string& key) {
+    m_args.assign({"LLEN", key});
+    return static_cast<size_t>(Execute(&RedisReplyConverter::Integer));
+}
+std::optional<std::string> RedisClient::lpop(const std::string& key) {
+    m_args.assign({"LPOP", key});
+    return Execute(&RedisReplyConverter::OptionalString);
+}
+long long RedisClient::lpush(const std::string& key, const std::vector<std::string>& values) {
+    m_args.assign({"LPUSH", key});
+    m_args.insert(m_args.end(), values.begin(), values.end());
+    return Execute(&RedisReplyConverter::Integer);
+}
+long long RedisClient::lpushx(const std::string& key, const std::string& value) {
+    m_args.assign({"LPUSHX", key, value});
+    return Execute(&RedisReplyConverter::Integer);
+}
+std::vector<std::string> RedisClient::lrange(const std::string& key, long long start, long long stop) {
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"LRANGE", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
+    return Execute(&RedisReplyConverter::StringArray);
+}
+int64_t RedisClient::lrem(const std::string& key, int count, const std::string& value) {
+    char number[32];
+    m_args.assign({"LREM", key, FormatArgument(number, (int64_t)count), value});
+    return Execute(&RedisReplyConverter::Integer);
+}
+bool RedisClient::lset(const std::string& key, long long index, const std::string& value) {
+    char number[32];
+    m_args.assign({"LSET", key, FormatArgument(number, (int64_t)index), value});
+    return Execute(&RedisReplyConverter::Status);
+}
+bool RedisClient::ltrim(const std::string& key, long long start, long long stop) {
+    char startNumber[32], stopNumber[32];
+    m_args.assign({"LTRIM", key, FormatArgument(startNumber, (int64_t)start), FormatArgument(stopNumber, (int64_t)stop)});
+    return Execute(&RedisReplyConverter::Status);
+}
+std::optional<std::string> RedisClient::rpop(const std::string& key) {
+    m_args.assign({"RPOP", key});
+    return Execute(&RedisReplyConverter::OptionalString);
+}
+std::string RedisClient::rpoplpush(const std::string& source, const std::string& destination) {
+    m_args.assign({"RPOPLPUSH", source, destination});
+    if (auto moved = Execute(&RedisReplyConverter::OptionalString)) {
+        return std::move(*moved);
+    }
+    throw std::runtime_error(IsBroken() ? "redis error, command : RPOPLPUSH, error message : connection lost"
+        : "Unexpected reply when executing RPOPLPUSH from " + source + " to " + destination);
+}
+long long RedisClient::rpush(const std::string& key, const std::vector<std::string>& values) {
+    m_args.assign({"RPUSH", key});
+    m_args.insert(m_args.end(), values.begin(), values.end());
+    return Execute(&RedisReplyConverter::Integer);
+}
+long long RedisClient::rpushx(const std::string& key, const std::string& value) {
+    m_args.assign({"RPUSHX", key, value});
+    return Execute(&RedisReplyConverter::Integer);
+}
+int64_t RedisClient::xack(const std::string& key, const std::string& group, const std::vector<std::string>& ids) {
+    m_args.assign({"XACK", key, group});
+    m_args.insert(m_args.end(), ids.begin(), ids.end());
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Integer(reply.get(), "XACK");
+}
+std::string RedisClient::xadd(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, const std::string& id) {
+    m_args.assign({"XADD", key, id});
+    for (auto& [field, value] : fields) {
+        m_args.emplace_back(field);
+        m_args.emplace_back(value);
+    }
+    auto reply = CommandArgv(m_args);
+    if (auto added = RedisReplyConverter::OptionalString(reply.get(), "XADD")) {
+        return *added;
+    }
+    throw std::runtime_error("Unexpected reply when executing XADD for key: " + key);
+}
+int64_t RedisClient::xdel(const std::string& key, const std::vector<std::string>& ids) {
+    m_args.assign({"XDEL", key});
+    m_args.insert(m_args.end(), ids.begin(), ids.end());
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Integer(reply.get(), "XDEL");
+}
+bool RedisClient::xgroup_create(const std::string& key, const std::string& group, const std::string& id, bool mkstream) {
+    m_args.assign({"XGROUP", "CREATE", key, group, id});
+    if (mkstream) {
+        m_args.emplace_back("MKSTREAM");
+    }
+    auto reply = CommandArgv(m_args);
+    /** the group is already there */
+    if (reply && reply->type == REDIS_REPLY_ERROR && std::string_view(reply->str, reply->len).substr(0, 9) == "BUSYGROUP") {
+        return false;
+    }
+    return RedisReplyConverter::Status(reply.get(), "XGROUP");
+}
+int64_t RedisClient::xlen(const std::string& key) {
+    m_args.assign({"XLEN", key});
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Integer(reply.get(), "XLEN");
+}
+std::vector<RedisStreamEntry> RedisClient::xrange(const std::string& key, const std::string& start, const std::string& end, size_t count) {
+    char countNumber[32];
+    m_args.assign({"XRANGE", key, start, end});
+    if (count > 0) {
+        m_args.insert(m_args.end(), {"COUNT", FormatArgument(countNumber, (int64_t)count)});
     }
-    cmd << timeout;
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::StreamEntries(reply.get(), "XRANGE");
+}
+int64_t RedisClient::xtrim(const std::string& key, size_t maxlen, bool approximate) {
+    char maxlenNumber[32];
+    m_args.assign({"XTRIM", key, "MAXLEN"});
+    if (approximate) {
+        m_args.emplace_back("~");
+    }
+    m_args.emplace_back(FormatArgument(maxlenNumber, (int64_t)maxlen));
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Integer(reply.get(), "XTRIM");
+}
+bool RedisClient::watch(const std::vector<std::string>& keys) {
+    m_args.assign({"WATCH"});
+    m_args.insert(m_args.end(), keys.begin(), keys.end());
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Status(reply.get(), "WATCH");
+}
+bool RedisClient::unwatch() {
+    m_args.assign({"UNWATCH"});
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Status(reply.get(), "UNWATCH");
+}
+RedisScanRange<std::string> RedisClient::scan(const std::string& pattern, size_t count, bool prefetch) {
+    return RedisScanRange<std::string>(*this, {"SCAN"}, pattern, count, prefetch);
+}
+RedisScanRange<std::string> RedisClient::sscan(const std::string& key, const std::string& pattern, size_t count, bool prefetch) {
+    return RedisScanRange<std::string>(*this, {"SSCAN", key}, pattern, count, prefetch);
+}
+RedisScanRange<std::pair<std::string, std::string>> RedisClient::hscan(const std::string& key, const std::string& pattern, size_t count, bool prefetch) {
+    return RedisScanRange<std::pair<std::string, std::string>>(*this, {"HSCAN", key}, pattern, count, prefetch);
+}
+RedisScanRange<std::pair<std::string, double>> RedisClient::zscan(const std::string& key, const std::string& pattern, size_t count, bool prefetch) {
+    return RedisScanRange<std::pair<std::string, double>>(*this, {"ZSCAN", key}, pattern, count, prefetch);
+}
 
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements == 2) {
-        auto keyReply = reply->element[0];
-        auto valueReply = reply->element[1];
-        if (keyReply->type == REDIS_REPLY_STRING && valueReply->type == REDIS_REPLY_STRING) {
-            return {std::string(keyReply->str, keyReply->len), std::string(valueReply->str, valueReply->len)};
+RedisScanCursor::RedisScanCursor(RedisClient& client, std::vector<std::string> command
+        , const std::string& pattern, size_t count, bool prefetch)
+    : m_client (client), m_command (std::move(command)), m_cursorIndex (m_command.size()), m_prefetch (prefetch) {
+    m_command.emplace_back("0");
+    if (!pattern.empty() && pattern != "*") {
+        m_command.emplace_back("MATCH");
+        m_command.push_back(pattern);
+    }
+    m_command.emplace_back("COUNT");
+    m_command.push_back(std::to_string(count ? count : 10));
+}
+RedisScanCursor::~RedisScanCursor() {
+    if (m_pending && m_client.m_context) {
+        redisReply* reply = nullptr;
+        if (redisGetReply(m_client.m_context.get(), (void**)&reply) == REDIS_OK) {
+            m_client.WrapReply(reply);
         }
-    } else {
-        throw std::runtime_error("Unexpected reply when executing BLPOP for keys");
     }
 }
-std::pair<std::string, std::string> RedisClient::brpop(const std::vector<std::string>& keys, int timeout) {
-    std::stringstream cmd;
-    cmd << "BRPOP ";
-    for (size_t i = 0; i < keys.size(); ++i) {
-        cmd << keys[i] << (i < keys.size() - 1 ? " " : "");
+void RedisScanCursor::Request() {
+    m_client.m_argv.resize(m_command.size());
+    m_client.m_argvlen.resize(m_command.size());
+    for (size_t i = 0; i < m_command.size(); ++i) {
+        m_client.m_argv[i] = m_command[i].data();
+        m_client.m_argvlen[i] = m_command[i].size();
+    }
+    if (redisAppendCommandArgv(m_client.m_context.get(), (int)m_command.size()
+        , m_client.m_argv.data(), m_client.m_argvlen.data()) != REDIS_OK) {
+        throw std::runtime_error("redis error, command : " + m_command[0] + ", error message : append failed");
+    }
+    m_pending = true;
+    /** appending only fills the output buffer, the page is requested once it is on the socket */
+    int done = 0;
+    while (!done) {
+        if (redisBufferWrite(m_client.m_context.get(), &done) != REDIS_OK) {
+            throw std::runtime_error("redis error, command : " + m_command[0] + ", error message : "
+                + std::string(m_client.m_context->errstr));
+        }
     }
-    cmd << timeout;
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_ARRAY && reply->elements == 2) {
-        auto keyReply = reply->element[0];
-        auto valueReply = reply->element[1];
-        if (keyReply->type == REDIS_REPLY_STRING && valueReply->type == REDIS_REPLY_STRING) {
-            return {std::string(keyReply->str, keyReply->len), std::string(valueReply->str, valueReply->len)};
+}
+const redisReply* RedisScanCursor::Fetch() {
+    /** Next copied the previous page out, dropped before the next one is read so the reply arena can rewind */
+    m_page.reset();
+    if (m_done) {
+        return nullptr;
+    }
+    RedisReplyPtr reply;
+    if (m_pending) {
+        m_pending = false;
+        redisReply* r = nullptr;
+        if (redisGetReply(m_client.m_context.get(), (void**)&r) != REDIS_OK) {
+            m_done = true;
         }
+        reply = m_client.WrapReply(r);
     } else {
-        throw std::runtime_error("Unexpected reply when executing BRPOP for keys");
+        reply = m_client.CommandArgv(std::vector<std::string_view>(m_command.begin(), m_command.end()));
+    }
+    CheckReply(reply.get(), m_command[0].c_str());
+    if (reply->type != REDIS_REPLY_ARRAY || reply->elements != 2
+        || reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY) {
+        throw std::runtime_error("Unexpected reply type when executing " + m_command[0]);
+    }
+    auto cursor = reply->element[0];
+    m_command[m_cursorIndex].assign(cursor->str, cursor->len);
+    if (m_command[m_cursorIndex] == "0") {
+        m_done = true;
+    } else if (m_prefetch) {
+        Request();
+    }
+    m_page = std::move(reply);
+    return m_page->element[1];
+}
+bool RedisScanCursor::Next(std::vector<std::string>& elements) {
+    auto page = Fetch();
+    if (!page) {
+        return false;
     }
+    elements.clear();
+    elements.reserve(page->elements);
+    for (size_t i = 0; i < page->elements; ++i) {
+        elements.emplace_back(page->element[i]->str, page->element[i]->len);
+    }
+    return true;
 }
-std::string RedisClient::brpoplpush(const std::string& source, const std::string& destination, int timeout) {
-    std::stringstream cmd;
-    cmd << "BRPOPLPUSH " << source << " " << destination << " " << timeout;
-
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len); 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing BRPOPLPUSH from " + source + " to " + destination);
+bool RedisScanCursor::Next(std::vector<std::pair<std::string, std::string>>& elements) {
+    auto page = Fetch();
+    if (!page) {
+        return false;
+    }
+    elements.clear();
+    elements.reserve(page->elements / 2);
+    for (size_t i = 0; i + 1 < page->elements; i += 2) {
+        auto field = page->element[i], value = page->element[i + 1];
+        elements.emplace_back(std::string(field->str, field->len), std::string(value->str, value->len));
     }
+    return true;
 }
-std::optional<std::string> RedisClient::lindex(const std::string& key, long long index) {
-    auto reply = Command("LINDEX %s %lld", key.c_str(), index);
-    if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt;
-    } else if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LINDEX for key: " + key);
+bool RedisScanCursor::Next(std::vector<std::pair<std::string, double>>& elements) {
+    auto page = Fetch();
+    if (!page) {
+        return false;
     }
+    elements.clear();
+    elements.reserve(page->elements / 2);
+    for (size_t i = 0; i + 1 < page->elements; i += 2) {
+        auto member = page->element[i], score = page->element[i + 1];
+        elements.emplace_back(std::string(member->str, member->len)
+            , score->type == REDIS_REPLY_DOUBLE ? score->dval : std::strtod(score->str, nullptr));
+    }
+    return true;
 }
-bool RedisClient::linsert(const std::string& key, const std::string& pivot, const std::string& value, bool before) {
-    std::string position = before ? "BEFORE" : "AFTER";
-    auto reply = Command("LINSERT %s %s %s %s %s", key.c_str(), position.c_str(), pivot.c_str(), value.c_str());
-
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer >= 0; 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LINSERT for key: " + key);
+RedisPipeline::RedisPipeline(RedisClient::Ptr client)
+    : m_client (client) {
+    if (!m_client || !m_client->m_context) {
+        throw std::runtime_error("redis pipeline without connection");
     }
 }
-size_t RedisClient::llen(const std::string& key) {
-    auto reply = Command("LLEN %s", key.c_str());
-
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return static_cast<size_t>(reply->integer);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LLEN for key: " + key);
+RedisPipeline::~RedisPipeline() {
+    if (m_callbacks.empty()) {
+        return;
+    }
+    /** the commands sit in the output buffer or were written by Flush, the next user of the connection
+     *  would read their replies. no I/O here, the connection is marked broken so it gets reconnected */
+    auto context = m_client->m_context.get();
+    if (context && !context->err) {
+        context->err = REDIS_ERR_OTHER;
+        snprintf(context->errstr, sizeof(context->errstr), "%s", "pipeline dropped without Exec");
+    }
+    for (auto& callback : m_callbacks) {
+        callback(nullptr);
     }
 }
-std::optional<std::string> RedisClient::lpop(const std::string& key) {
-    auto reply = Command("LPOP %s", key.c_str());
-    if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt;
-    } else if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LPOP for key: " + key);
+std::future<RedisReplyPtr> RedisPipeline::Command(const std::vector<std::string_view>& argv) {
+    if (argv.empty()) {
+        throw std::runtime_error("redis pipeline empty command");
+    }
+    auto promise = std::make_shared<std::promise<RedisReplyPtr>>();
+    auto future = promise->get_future();
+    Append(argv.data(), argv.size(), [promise](RedisReplyPtr reply) {
+        if (!reply) {
+            promise->set_exception(std::make_exception_ptr(
+                std::runtime_error("redis error, pipeline command without reply")));
+            return;
+        }
+        promise->set_value(std::move(reply));
+    });
+    return future;
+}
+bool RedisPipeline::Flush() {
+    auto context = m_client->m_context.get();
+    int done = 0;
+    while (!done) {
+        if (redisBufferWrite(context, &done) != REDIS_OK) {
+            return false;
+        }
     }
+    return true;
 }
-long long RedisClient::lpush(const std::string& key, const std::vector<std::string>& values) {
-    std::stringstream cmd;
-    cmd << "LPUSH " << key;
-    for (const auto& value : values) {
-        cmd << " " << value;
+size_t RedisPipeline::Exec() {
+    auto callbacks = std::move(m_callbacks);
+    m_callbacks.clear();
+    auto context = m_client->m_context.get();
+    for (size_t i = 0; i < callbacks.size(); ++i) {
+        redisReply* reply = nullptr;
+        if (redisGetReply(context, (void**)&reply) != REDIS_OK) {
+            /** connection is broken, the rest of the replies will never arrive */
+            for (; i < callbacks.size(); ++i) {
+                callbacks[i](nullptr);
+            }
+            throw std::runtime_error(std::string("redis pipeline error, error message : ") + context->errstr);
+        }
+        callbacks[i](m_client->WrapReply(reply));
+    }
+    return callbacks.size();
+}
+void RedisPipeline::Append(const std::string_view* argv, size_t argc, std::function<void(RedisReplyPtr)> callback) {
+    m_argv.clear();
+    m_argvlen.clear();
+    for (size_t i = 0; i < argc; ++i) {
+        m_argv.push_back(argv[i].data());
+        m_argvlen.push_back(argv[i].size());
+    }
+    if (redisAppendCommandArgv(m_client->m_context.get(), (int)argc, m_argv.data(), m_argvlen.data()) != REDIS_OK) {
+        throw std::runtime_error(std::string("redis pipeline append error, command : ")
+            + std::string(argv[0]));
+    }
+    m_callbacks.push_back(std::move(callback));
+}
+RedisTransaction::RedisTransaction(RedisClient::Ptr client)
+    : m_client (client) {
+    if (!m_client || !m_client->m_context) {
+        throw std::runtime_error("redis transaction without connection");
+    }
+}
+void RedisTransaction::Append(const std::string_view* argv, size_t argc, Callback callback) {
+    if (m_buffer.empty()) {
+        m_buffer.append("*1\r\n$5\r\nMULTI\r\n");
+    }
+    RedisAppendCommand(m_buffer, argv, argc);
+    m_callbacks.push_back(std::move(callback));
+}
+void RedisTransaction::Fail(std::vector<Callback>& callbacks, const char* failure) {
+    for (auto& callback : callbacks) {
+        callback(nullptr, failure);
+    }
+}
+bool RedisTransaction::Exec() {
+    auto callbacks = std::move(m_callbacks);
+    m_callbacks.clear();
+    if (m_buffer.empty()) {
+        m_buffer.append("*1\r\n$5\r\nMULTI\r\n");
+    }
+    m_buffer.append("*1\r\n$4\r\nEXEC\r\n");
+    auto context = m_client->m_context.get();
+    auto appended = redisAppendFormattedCommand(context, m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+    if (appended != REDIS_OK) {
+        Fail(callbacks, "append failed");
+        throw std::runtime_error(std::string("redis transaction append error, error message : ") + context->errstr);
+    }
+    /** +OK for MULTI, +QUEUED or an error per command, then the EXEC reply */
+    std::string refused;
+    RedisReplyPtr exec;
+    for (size_t i = 0; i < callbacks.size() + 2; ++i) {
+        redisReply* reply = nullptr;
+        if (redisGetReply(context, (void**)&reply) != REDIS_OK) {
+            Fail(callbacks, "connection lost");
+            throw std::runtime_error(std::string("redis transaction error, error message : ") + context->errstr);
+        }
+        auto wrapped = m_client->WrapReply(reply);
+        if (i == callbacks.size() + 1) {
+            exec = std::move(wrapped);
+        } else if (wrapped->type == REDIS_REPLY_ERROR && refused.empty()) {
+            refused.assign(wrapped->str, wrapped->len);
+        }
+    }
+    if (exec->type == REDIS_REPLY_NIL) {
+        Fail(callbacks, "aborted, a watched key changed");
+        return false;
+    }
+    if (exec->type == REDIS_REPLY_ERROR) {
+        auto error = refused.empty() ? std::string(exec->str, exec->len) : refused;
+        Fail(callbacks, error.c_str());
+        throw std::runtime_error("redis transaction error, error message : " + error);
+    }
+    if (exec->type != REDIS_REPLY_ARRAY || exec->elements != callbacks.size()) {
+        Fail(callbacks, "unexpected EXEC reply");
+        throw std::runtime_error("Unexpected reply when executing EXEC");
     }
+    /** a command failing at run time (WRONGTYPE ...) only fails its own future */
+    for (size_t i = 0; i < callbacks.size(); ++i) {
+        callbacks[i](exec->element[i], nullptr);
+    }
+    return true;
+}
+void RedisAppendCommand(std::string& buffer, const std::string_view* argv, size_t argc) {
+    char header[24];
+    auto length = [&buffer, &header](char prefix, size_t value) {
+        header[0] = prefix;
+        auto [end, ec] = std::to_chars(header + 1, header + sizeof(header) - 2, value);
+        *end++ = '\r';
+        *end++ = '\n';
+        buffer.append(header, end - header);
+    };
+    length('*', argc);
+    for (size_t i = 0; i < argc; ++i) {
+        length('$', argv[i].size());
+        buffer.append(argv[i].data(), argv[i].size()).append("\r\n", 2);
+    }
+}
+bool RedisIsReadOnlyCommand(std::string_view command) {
+    static const std::array<std::string_view, 46> commands {
+        "DUMP", "EXISTS", "GET", "GETBIT", "GETRANGE", "HEXISTS", "HGET", "HGETALL", "HKEYS", "HLEN", "HMGET",
+        "HSCAN", "HSTRLEN", "HVALS", "KEYS", "LINDEX", "LLEN", "LRANGE", "MGET", "PTTL", "RANDOMKEY", "SCAN",
+        "SCARD", "SDIFF", "SINTER", "SISMEMBER", "SMEMBERS", "SRANDMEMBER", "SSCAN", "STRLEN", "SUNION", "TTL",
+        "TYPE", "ZCARD", "ZCOUNT", "ZLEXCOUNT", "ZRANGE", "ZRANGEBYLEX", "ZRANGEBYSCORE", "ZRANK", "ZREVRANGE",
+        "ZREVRANGEBYLEX", "ZREVRANGEBYSCORE", "ZREVRANK", "ZSCAN", "ZSCORE"
+    };
+    return std::binary_search(commands.begin(), commands.end(), command);
+}
+RedisConnectPool::~RedisConnectPool() {
+    StopWorker();
+}
+void RedisConnectPool::Connect(const std::string& ip, const uint16_t port
+        , size_t count, int64_t ms, const std::string& password) {
+    RedisConnectPoolOptions options;
+    options.host = ip;
+    options.port = port;
+    options.password = password;
+    options.max_connections = count;
+    options.connect_timeout_ms = ms;
+    Connect(options);
+}
+void RedisConnectPool::Connect(const RedisConnectPoolOptions& options) {
+    StopWorker();
+    m_options = options;
+    if (!m_options.sentinels.empty()) {
+        /** host:port of the options stay the fallback when no sentinel answers */
+        QueryMaster(m_options.host, m_options.port);
+    }
+    m_replicas.clear();
+    for (auto& [host, port] : options.replicas) {
+        auto replica = options;
+        replica.host = host;
+        replica.port = port;
+        replica.replicas.clear();
+        /** a replica pool stays on its own node, failovers re-point only the master pool */
+        replica.sentinels.clear();
+        replica.master_name.clear();
+        m_replicas.push_back(std::make_shared<RedisConnectPool>());
+        m_replicas.back()->Connect(replica);
+    }
+    m_options.max_connections = m_options.max_connections ? m_options.max_connections : 1;
+    m_options.min_connections = std::min(m_options.min_connections, m_options.max_connections);
+    m_slots.reset(new Slot[m_options.max_connections]);
+    m_size = m_options.max_connections;
+    m_freeHead.store(MakeHead(0, npos));
+    m_vacantHead.store(MakeHead(0, npos));
+    m_freeCount.store(0);
+    m_live.store(0);
+    m_growAfter.store(0);
+    m_broken.clear();
 
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LPUSH for key: " + key);
+    /** the initial connections are established in parallel, each one bounded by the connect timeout */
+    std::vector<std::future<bool>> opens;
+    for (size_t i = 0; i < m_options.min_connections; ++i) {
+        opens.push_back(std::async(std::launch::async, &RedisConnectPool::Open, this, (uint32_t)i));
+    }
+    for (size_t i = m_size; i > m_options.min_connections; --i) {
+        Push(m_vacantHead, i - 1);
+    }
+    for (size_t i = opens.size(); i > 0; --i) {
+        if (opens[i - 1].get()) {
+            Release(i - 1);
+        } else {
+            Push(m_vacantHead, i - 1);
+        }
+    }
+
+    m_workerStop = false;
+    m_worker = std::thread(&RedisConnectPool::Maintain, this);
+    if (!m_options.sentinels.empty()) {
+        m_sentinelWatcher = std::thread(&RedisConnectPool::WatchSentinels, this);
+    }
+}
+RedisConnectPool* RedisConnectPool::ReadPool(RedisConsistency consistency) {
+    if (consistency == RedisConsistency::strong || m_replicas.empty()) {
+        return this;
+    }
+    /** a replica without a live connection is down or reconnecting, its reads go elsewhere */
+    auto start = m_nextReplica.fetch_add(1, std::memory_order_relaxed);
+    RedisConnectPool* best = nullptr;
+    size_t bestOutstanding = SIZE_MAX;
+    for (size_t i = 0; i < m_replicas.size(); ++i) {
+        auto replica = m_replicas[(start + i) % m_replicas.size()].get();
+        auto live = replica->ConnectPoolSize();
+        if (live == 0) {
+            continue;
+        }
+        if (m_options.replica_balance == RedisReplicaBalance::round_robin) {
+            return replica;
+        }
+        auto free = replica->FreeConnectionSize();
+        auto outstanding = live > free ? live - free : 0;
+        if (outstanding < bestOutstanding) {
+            best = replica;
+            bestOutstanding = outstanding;
+        }
+    }
+    return best ? best : this;
+}
+bool RedisConnectPool::Open(uint32_t index) {
+    std::string host;
+    uint16_t port;
+    uint64_t generation;
+    {
+        std::lock_guard guard(m_endpointMutex);
+        host = m_options.host, port = m_options.port;
+        generation = m_generation.load();
+    }
+    auto conn = std::make_shared<RedisClient>();
+    try {
+        if (!conn->ConnectWithTimeout(host, port, m_options.connect_timeout_ms, m_options.password)) {
+            throw std::runtime_error("redis pool connect error:( " + host + " : " + std::to_string(port));
+        }
+    } catch (const std::exception& e) {
+        m_connectFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "connect", e);
+        return false;
     }
+    m_slots[index].conn = conn;
+    /** a switch during the connect leaves this connection stale, it is replaced on first use */
+    m_slots[index].generation = generation;
+    m_slots[index].lastUsed.store(NowMs(), std::memory_order_relaxed);
+    m_live.fetch_add(1, std::memory_order_relaxed);
+    m_opened.fetch_add(1, std::memory_order_relaxed);
+    return true;
 }
-long long RedisClient::lpushx(const std::string& key, const std::string& value) {
-    auto reply = Command("LPUSHX %s %s", key.c_str(), value.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else if (reply && reply->type == REDIS_REPLY_NIL) {
-        return -1; 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LPUSHX for key: " + key);
+uint32_t RedisConnectPool::Grow() {
+    if (m_reaping.load()) {
+        /** the reaper holds the idle connections for a moment, they are about to come back */
+        {
+            std::unique_lock lock(m_reapMutex);
+            m_reapCond.wait(lock, [this]() { return !m_reaping.load(); });
+        }
+        if (m_waiterCount.load() == 0) {
+            if (auto index = Pop(m_freeHead); index != npos) {
+                m_freeCount.fetch_sub(1, std::memory_order_relaxed);
+                return index;
+            }
+        }
+    }
+    /** after a failed connect the server is likely down, do not make every checkout pay the connect timeout */
+    if (NowMs() < m_growAfter.load(std::memory_order_relaxed)) {
+        return npos;
     }
+    auto index = Pop(m_vacantHead);
+    if (index == npos) {
+        return npos;
+    }
+    if (!Open(index)) {
+        m_growAfter.store(NowMs() + m_options.reconnect_backoff_min_ms, std::memory_order_relaxed);
+        Push(m_vacantHead, index);
+        return npos;
+    }
+    return index;
 }
-std::vector<std::string> RedisClient::lrange(const std::string& key, long long start, long long stop) {
-    std::string command = "LRANGE " + key + " " + std::to_string(start) + " " + std::to_string(stop);
-    auto reply = Command(command.c_str());
+uint32_t RedisConnectPool::Checkout(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        auto index = Acquire(std::max(left, std::chrono::milliseconds(0)));
+        if (index == npos) {
+            return npos;
+        }
+        auto& slot = m_slots[index];
+        auto idle = NowMs() - slot.lastUsed.load(std::memory_order_relaxed);
+        if (!slot.conn->IsBroken() && !IsStale(index)
+            && (m_options.validate_idle_ms <= 0 || idle <= m_options.validate_idle_ms || slot.conn->Ping())) {
+            return index;
+        }
+        Discard(index);
+    }
+}
+void RedisConnectPool::Discard(uint32_t index) {
+    m_slots[index].conn.reset();
+    m_live.fetch_sub(1, std::memory_order_relaxed);
+    m_brokenCount.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard guard(m_workerMutex);
+        m_broken.push_back({index, NowMs(), m_options.reconnect_backoff_min_ms});
+    }
+    m_workerCond.notify_one();
+}
+void RedisConnectPool::Maintain() {
+    auto interval = m_options.idle_ttl_ms > 0 && m_options.min_connections < m_size
+        ? std::max<int64_t>(m_options.idle_ttl_ms / 2, 1) : 0;
+    auto nextReap = NowMs() + interval;
+    std::unique_lock lock(m_workerMutex);
+    while (!m_workerStop) {
+        auto now = NowMs();
+        auto deadline = interval ? nextReap : now + 1000;
+        for (auto& broken : m_broken) {
+            deadline = std::min(deadline, broken.retryAt);
+        }
+        if (deadline > now) {
+            m_workerCond.wait_for(lock, std::chrono::milliseconds(deadline - now));
+            continue;
+        }
+        std::vector<Broken> due;
+        auto it = std::partition(m_broken.begin(), m_broken.end(), [now](const Broken& broken) {
+            return broken.retryAt > now;
+        });
+        due.assign(it, m_broken.end());
+        m_broken.erase(it, m_broken.end());
+        lock.unlock();
 
-    if (reply && reply->type == REDIS_REPLY_ARRAY) {
-        std::vector<std::string> elements;
-        for (size_t i = 0; i < reply->elements; ++i) {
-            if (reply->element[i]->type == REDIS_REPLY_STRING) {
-                elements.push_back(std::string(reply->element[i]->str, reply->element[i]->len));
+        /** a reconnected slot goes through Release, so a waiting caller receives it at once */
+        std::vector<Broken> retry;
+        for (auto& broken : due) {
+            if (Open(broken.index)) {
+                m_reconnects.fetch_add(1, std::memory_order_relaxed);
+                Release(broken.index);
+            } else {
+                broken.retryAt = NowMs() + broken.backoff;
+                broken.backoff = std::min(broken.backoff * 2, m_options.reconnect_backoff_max_ms);
+                retry.push_back(broken);
             }
         }
-        return elements;
-    } else if (reply && reply->type == REDIS_REPLY_NIL) {
-        return {}; 
-    } else {
-        throw std::runtime_error("Unexpected reply type when executing LRANGE for key: " + key);
+        if (interval && NowMs() >= nextReap) {
+            Reap();
+            nextReap = NowMs() + interval;
+        }
+
+        lock.lock();
+        m_broken.insert(m_broken.end(), retry.begin(), retry.end());
+    }
+}
+void RedisConnectPool::Reap() {
+    std::vector<uint32_t> idle;
+    m_reaping.store(true);
+    for (auto index = Pop(m_freeHead); index != npos; index = Pop(m_freeHead)) {
+        idle.push_back(index);
+    }
+    auto now = NowMs();
+    auto live = m_live.load();
+    std::vector<uint32_t> expired;
+    std::vector<uint32_t> keep;
+    for (auto index : idle) {
+        if (live > m_options.min_connections
+            && now - m_slots[index].lastUsed.load(std::memory_order_relaxed) > m_options.idle_ttl_ms) {
+            expired.push_back(index);
+            --live;
+        } else {
+            keep.push_back(index);
+        }
+    }
+    /** push back in reverse so the most recently used connection stays on top */
+    for (auto it = keep.rbegin(); it != keep.rend(); ++it) {
+        Push(m_freeHead, *it);
+    }
+    m_freeCount.fetch_sub(expired.size(), std::memory_order_relaxed);
+    EndReaping();
+    if (m_waiterCount.load() != 0) {
+        HandOff();
+    }
+    for (auto index : expired) {
+        m_slots[index].conn.reset();
+        m_live.fetch_sub(1, std::memory_order_relaxed);
+        m_reaped.fetch_add(1, std::memory_order_relaxed);
+        Push(m_vacantHead, index);
     }
 }
-int64_t RedisClient::lrem(const std::string& key, int count, const std::string& value) {
-    auto reply = Command("LREM %s %d %s", key.c_str(), count, value.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LREM for key: " + key);
+void RedisConnectPool::EndReaping() {
+    {
+        std::lock_guard guard(m_reapMutex);
+        m_reaping.store(false);
     }
+    m_reapCond.notify_all();
 }
-bool RedisClient::lset(const std::string& key, long long index, const std::string& value) {
-    auto reply = Command("LSET %s %lld %s %s", key.c_str(), index, value.c_str());
-    if (reply && reply->type == REDIS_REPLY_STATUS) {
-        return std::strcmp(reply->str, "OK") == 0;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LSET for key: " + key);
+void RedisConnectPool::StopWorker() {
+    {
+        std::lock_guard guard(m_workerMutex);
+        m_workerStop = true;
+    }
+    {
+        /** wakes the sentinel watcher out of its blocking read */
+        std::lock_guard guard(m_endpointMutex);
+        if (m_sentinel && m_sentinel->m_context) {
+            ::shutdown(m_sentinel->m_context->fd, SHUT_RDWR);
+        }
+    }
+    m_workerCond.notify_all();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+    if (m_sentinelWatcher.joinable()) {
+        m_sentinelWatcher.join();
     }
 }
-bool RedisClient::ltrim(const std::string& key, long long start, long long stop) {
-    auto reply = Command("LTRIM %s %lld %lld", key.c_str(), start, stop);
-    if (reply && reply->type == REDIS_REPLY_STATUS) {
-        return std::strcmp(reply->str, "OK") == 0;
-    } else {
-        throw std::runtime_error("Unexpected reply when executing LTRIM for key: " + key);
+std::string RedisConnectPool::Endpoint() const {
+    std::lock_guard guard(m_endpointMutex);
+    return m_options.host + ":" + std::to_string(m_options.port);
+}
+void RedisConnectPool::Repoint(const std::string& host, uint16_t port) {
+    {
+        std::lock_guard guard(m_endpointMutex);
+        if (m_options.host == host && m_options.port == port) {
+            return;
+        }
+        m_options.host = host;
+        m_options.port = port;
+        m_generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+    m_failovers.fetch_add(1, std::memory_order_relaxed);
+    m_growAfter.store(0);
+
+    /** idle connections are drained now, checked out ones when they come back through Release */
+    std::vector<uint32_t> idle;
+    m_reaping.store(true);
+    for (auto index = Pop(m_freeHead); index != npos; index = Pop(m_freeHead)) {
+        idle.push_back(index);
+    }
+    m_freeCount.fetch_sub(idle.size(), std::memory_order_relaxed);
+    EndReaping();
+    for (auto index : idle) {
+        Discard(index);
     }
 }
-std::optional<std::string> RedisClient::rpop(const std::string& key) {
-    auto reply = Command("RPOP %s", key.c_str());
-    if (reply && reply->type == REDIS_REPLY_NIL) {
-        return std::nullopt;
-    } else if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing RPOP for key: " + key);
+bool RedisConnectPool::QueryMaster(std::string& host, uint16_t& port) {
+    for (auto& [sentinelHost, sentinelPort] : m_options.sentinels) {
+        if (QueryMaster(sentinelHost, sentinelPort, host, port)) {
+            return true;
+        }
     }
+    return false;
 }
-std::string RedisClient::rpoplpush(const std::string& source, const std::string& destination) {
-    auto reply = Command("RPOPLPUSH %s %s %s", source.c_str(), destination.c_str());
-    if (reply && reply->type == REDIS_REPLY_STRING) {
-        return std::string(reply->str, reply->len);
-    } else {
-        throw std::runtime_error("Unexpected reply when executing RPOPLPUSH from " + source + " to " + destination);
+bool RedisConnectPool::QueryMaster(const std::string& sentinelHost, uint16_t sentinelPort, std::string& host, uint16_t& port) {
+    try {
+        RedisClient sentinel;
+        if (!sentinel.ConnectWithTimeout(sentinelHost, sentinelPort, m_options.connect_timeout_ms, m_options.sentinel_password)) {
+            return false;
+        }
+        auto reply = sentinel.CommandArgv({"SENTINEL", "get-master-addr-by-name", m_options.master_name});
+        if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+            return false;
+        }
+        host.assign(reply->element[0]->str, reply->element[0]->len);
+        port = (uint16_t)std::stoi(std::string(reply->element[1]->str, reply->element[1]->len));
+        return true;
+    } catch (const std::exception& e) {
+        m_sentinelErrors.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "sentinel", e);
+        return false;
     }
 }
-long long RedisClient::rpush(const std::string& key, const std::vector<std::string>& values) {
-    std::stringstream cmd;
-    cmd << "RPUSH " << key;
-    for (const auto& value : values) {
-        cmd << " " << value;
+void RedisConnectPool::WatchSentinels() {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    for (size_t next = 0; ; ++next) {
+        auto& [sentinelHost, sentinelPort] = m_options.sentinels[next % m_options.sentinels.size()];
+        auto sentinel = std::make_shared<RedisClient>();
+        bool subscribed = false;
+        try {
+            if (sentinel->ConnectWithTimeout(sentinelHost, sentinelPort, m_options.connect_timeout_ms, m_options.sentinel_password)) {
+                auto reply = sentinel->CommandArgv({"SUBSCRIBE", "+switch-master"});
+                subscribed = reply && reply->type == REDIS_REPLY_ARRAY;
+            }
+        } catch (const std::exception& e) {
+            m_sentinelErrors.fetch_add(1, std::memory_order_relaxed);
+            RedisReportError(m_options.error_handler, "sentinel", e);
+        }
+        if (subscribed) {
+            {
+                /** checked under the lock StopWorker takes, so it either shuts this socket down or we see the stop */
+                std::lock_guard guard(m_endpointMutex);
+                std::lock_guard stop(m_workerMutex);
+                if (m_workerStop) {
+                    break;
+                }
+                m_sentinel = sentinel;
+            }
+            backoff = m_options.reconnect_backoff_min_ms;
+            /** a switch may have happened while nobody listened, subscribed first so none is missed from now on */
+            std::string host;
+            uint16_t port;
+            if (QueryMaster(sentinelHost, sentinelPort, host, port)) {
+                Repoint(host, port);
+            }
+
+            auto context = sentinel->m_context.get();
+            redisReply* r = nullptr;
+            while (redisGetReply(context, (void**)&r) == REDIS_OK) {
+                auto reply = sentinel->WrapReply(r);
+                if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 3
+                    || reply->element[2]->type != REDIS_REPLY_STRING) {
+                    continue;
+                }
+                /** "<master name> <old ip> <old port> <new ip> <new port>" */
+                std::istringstream payload(std::string(reply->element[2]->str, reply->element[2]->len));
+                std::string name, oldHost, oldPort, newHost;
+                uint16_t newPort = 0;
+                if ((payload >> name >> oldHost >> oldPort >> newHost >> newPort) && name == m_options.master_name) {
+                    Repoint(newHost, newPort);
+                }
+            }
+            std::lock_guard guard(m_endpointMutex);
+            m_sentinel.reset();
+        }
+
+        std::unique_lock lock(m_workerMutex);
+        if (m_workerCond.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return m_workerStop; })) {
+            break;
+        }
+        backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+    }
+}
+RedisConnectPoolStats RedisConnectPool::Stats() const {
+    RedisConnectPoolStats stats;
+    stats.checkouts = m_checkouts.load(std::memory_order_relaxed);
+    stats.waits = m_waits.load(std::memory_order_relaxed);
+    stats.timeouts = m_timeouts.load(std::memory_order_relaxed);
+    stats.waiters = m_waiterCount.load(std::memory_order_relaxed);
+    stats.peak_waiters = m_peakWaiters.load(std::memory_order_relaxed);
+    stats.opened = m_opened.load(std::memory_order_relaxed);
+    stats.reaped = m_reaped.load(std::memory_order_relaxed);
+    stats.broken = m_brokenCount.load(std::memory_order_relaxed);
+    stats.reconnects = m_reconnects.load(std::memory_order_relaxed);
+    stats.connect_failures = m_connectFailures.load(std::memory_order_relaxed);
+    stats.failovers = m_failovers.load(std::memory_order_relaxed);
+    stats.sentinel_errors = m_sentinelErrors.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < m_waitHistogram.size(); ++i) {
+        stats.wait_histogram[i] = m_waitHistogram[i].load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+uint32_t RedisConnectPool::AcquireWait(std::chrono::milliseconds timeout) {
+    std::unique_lock lock(m_waitMutex);
+    auto waiters = m_waiterCount.fetch_add(1) + 1;
+    /** a connection may have been returned before we were counted, Release only hands off to counted waiters */
+    if (m_waiters.empty()) {
+        if (auto index = Pop(m_freeHead); index != npos) {
+            m_freeCount.fetch_sub(1, std::memory_order_relaxed);
+            m_waiterCount.fetch_sub(1);
+            return index;
+        }
+    }
+    if (timeout.count() <= 0) {
+        m_waiterCount.fetch_sub(1);
+        m_timeouts.fetch_add(1, std::memory_order_relaxed);
+        return npos;
+    }
+    auto peak = m_peakWaiters.load(std::memory_order_relaxed);
+    while (peak < waiters && !m_peakWaiters.compare_exchange_weak(peak, waiters, std::memory_order_relaxed)) {
     }
 
-    auto reply = Command(cmd.str().c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer; 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing RPUSH for key: " + key);
+    Waiter waiter;
+    m_waiters.push_back(&waiter);
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + timeout;
+    /** grown by the head waiter after a connection was handed to it anyway */
+    uint32_t spare = npos;
+    while (waiter.index == npos) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            break;
+        }
+        if (m_waiters.front() != &waiter) {
+            waiter.cond.wait_until(lock, deadline);
+            continue;
+        }
+        /** the head waiter keeps trying to grow, after a server blip there may be nothing left to return */
+        lock.unlock();
+        auto index = Grow();
+        lock.lock();
+        if (index != npos) {
+            if (waiter.index == npos) {
+                m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &waiter));
+                waiter.index = index;
+            } else {
+                spare = index;
+            }
+            break;
+        }
+        if (waiter.index == npos) {
+            auto retry = std::max<int64_t>(m_growAfter.load(std::memory_order_relaxed) - NowMs(), m_options.reconnect_backoff_min_ms);
+            waiter.cond.wait_until(lock, std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(retry)));
+        }
     }
+    if (waiter.index == npos) {
+        m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &waiter));
+        m_timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!m_waiters.empty()) {
+        /** the next waiter may be the head now */
+        m_waiters.front()->cond.notify_one();
+    }
+    m_waiterCount.fetch_sub(1);
+    RecordWait(std::chrono::steady_clock::now() - start);
+    lock.unlock();
+    if (spare != npos) {
+        Release(spare);
+    }
+    return waiter.index;
 }
-long long RedisClient::rpushx(const std::string& key, const std::string& value) {
-    auto reply = Command("RPUSHX %s %s", key.c_str(), value.c_str());
-    if (reply && reply->type == REDIS_REPLY_INTEGER) {
-        return reply->integer; 
-    } else if (reply && reply->type == REDIS_REPLY_NIL) {
-        return -1; 
-    } else {
-        throw std::runtime_error("Unexpected reply when executing RPUSHX for key: " + key);
+void RedisConnectPool::HandOff() {
+    std::lock_guard guard(m_waitMutex);
+    while (!m_waiters.empty()) {
+        auto index = Pop(m_freeHead);
+        if (index == npos) {
+            return;
+        }
+        m_freeCount.fetch_sub(1, std::memory_order_relaxed);
+        auto waiter = m_waiters.front();
+        m_waiters.pop_front();
+        waiter->index = index;
+        waiter->cond.notify_one();
+    }
+    if (!m_waiters.empty()) {
+        m_waiters.front()->cond.notify_one();
     }
-}
\ No newline at end of file
+}
+void RedisConnectPool::RecordWait(std::chrono::steady_clock::duration waited) {
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(waited).count();
+    size_t bucket = 0;
+    while (us > 1 && bucket + 1 < m_waitHistogram.size()) {
+        us >>= 1;
+        ++bucket;
+    }
+    m_waits.fetch_add(1, std::memory_order_relaxed);
+    m_waitHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
@@ -11,19 +11,29 @@
 #ifndef ____REDIS_H____
 #define ____REDIS_H____
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <initializer_list>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <stdexcept>
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
 #include "hiredis.h"
+#include "byte_array.h"
 
 enum class RedisDataType : int8_t {
     none,
@@ -35,14 +45,237 @@ enum class RedisDataType : int8_t {
 };
 
 struct RedisReplyDistory {
+    /** replies built by a RedisReplyArena are given back to it instead of freeReplyObject */
+    void (*release)(void*) = freeReplyObject;
     void operator()(redisReply* reply) {
-        if (reply) freeReplyObject(reply);
+        if (reply) release(reply);
     }
 };
 
 using RedisReplyPtr = std::unique_ptr<redisReply, RedisReplyDistory>;
 
+/** receives the failures of a background thread, what names the step that failed (connect, pop, handler ...) */
+using RedisErrorHandler = std::function<void(const char* what, const std::exception& e)>;
+
+/** calls handler if there is one, an exception it throws is dropped so the background thread keeps running */
+inline void RedisReportError(const RedisErrorHandler& handler, const char* what, const std::exception& e) noexcept {
+    if (handler) {
+        try {
+            handler(what, e);
+        } catch (...) {
+        }
+    }
+}
+
+/**
+ * @brief read-only view of a reply that owns it, strings are exposed as std::string_view into the reply
+ *        so nothing is copied, the views are valid as long as the RedisReplyView lives.
+ *        a string reply is one value, an array reply (ARRAY, SET, MAP) is iterated element by element,
+ *        nil elements read as an empty view and can be told apart with IsNil(i)
+ */
+class RedisReplyView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+        explicit Iterator(redisReply** element = nullptr) : m_element (element) {}
+        std::string_view operator*() const { return RedisReplyView::ToView(*m_element); }
+        std::string_view operator[](difference_type n) const { return RedisReplyView::ToView(m_element[n]); }
+        Iterator& operator++() { ++m_element; return *this; }
+        Iterator operator++(int) { auto it = *this; ++m_element; return it; }
+        Iterator& operator--() { --m_element; return *this; }
+        Iterator operator--(int) { auto it = *this; --m_element; return it; }
+        Iterator& operator+=(difference_type n) { m_element += n; return *this; }
+        Iterator& operator-=(difference_type n) { m_element -= n; return *this; }
+        Iterator operator+(difference_type n) const { return Iterator(m_element + n); }
+        Iterator operator-(difference_type n) const { return Iterator(m_element - n); }
+        difference_type operator-(const Iterator& other) const { return m_element - other.m_element; }
+        bool operator==(const Iterator& other) const { return m_element == other.m_element; }
+        bool operator!=(const Iterator& other) const { return m_element != other.m_element; }
+        bool operator<(const Iterator& other) const { return m_element < other.m_element; }
+    private:
+        redisReply** m_element;
+    };
+
+    RedisReplyView() = default;
+    explicit RedisReplyView(RedisReplyPtr reply) : m_reply (std::move(reply)) {}
+
+    /** the whole reply is nil (GET of a missing key ...) */
+    bool IsNil() const { return !m_reply || m_reply->type == REDIS_REPLY_NIL; }
+    bool IsNil(size_t i) const { return m_reply->element[i]->type == REDIS_REPLY_NIL; }
+    /** value of a string reply */
+    std::string_view Str() const { return IsNil() ? std::string_view() : ToView(m_reply.get()); }
+    size_t size() const { return IsArray() ? m_reply->elements : 0; }
+    bool empty() const { return size() == 0; }
+    std::string_view operator[](size_t i) const { return ToView(m_reply->element[i]); }
+    /** key and value of the i-th pair of a flattened map (HGETALL, ZRANGE WITHSCORES ...) */
+    std::pair<std::string_view, std::string_view> Pair(size_t i) const {
+        return {ToView(m_reply->element[2 * i]), ToView(m_reply->element[2 * i + 1])};
+    }
+    size_t PairCount() const { return size() / 2; }
+    Iterator begin() const { return Iterator(IsArray() ? m_reply->element : nullptr); }
+    Iterator end() const { return begin() + size(); }
+    const redisReply* Get() const { return m_reply.get(); }
+private:
+    bool IsArray() const {
+        return m_reply && (m_reply->type == REDIS_REPLY_ARRAY
+            || m_reply->type == REDIS_REPLY_SET || m_reply->type == REDIS_REPLY_MAP);
+    }
+    static std::string_view ToView(const redisReply* reply) {
+        return reply->str ? std::string_view(reply->str, reply->len) : std::string_view();
+    }
+private:
+    RedisReplyPtr m_reply;
+};
+
+/** one entry of a stream, fields in the order they were added. no field at all marks an entry deleted since it was delivered */
+struct RedisStreamEntry {
+    std::string id;
+    std::vector<std::pair<std::string, std::string>> fields;
+    /** members of an object listed by RAPIDJSON_REFLECTION_PARSE from the fields of the same name, false when none is present */
+    template <typename T>
+    bool Decode(T& object) const;
+};
+
+/**
+ * typed conversion of one reply, shared by every command front end.
+ * an error reply throws. a lost connection (null reply) reads as nil where the result has one,
+ * nullopt for the Optional conversions and false for Boolean, and throws for all others
+ */
+struct RedisReplyConverter {
+    static bool Status(const redisReply* reply, const char* command);
+    static bool Boolean(const redisReply* reply, const char* command);
+    static int64_t Integer(const redisReply* reply, const char* command);
+    static std::optional<int64_t> OptionalInteger(const redisReply* reply, const char* command);
+    static double Double(const redisReply* reply, const char* command);
+    static std::optional<std::string> OptionalString(const redisReply* reply, const char* command);
+    static std::optional<double> OptionalDouble(const redisReply* reply, const char* command);
+    static std::vector<std::string> StringArray(const redisReply* reply, const char* command);
+    static std::vector<std::optional<std::string>> OptionalStringArray(const redisReply* reply, const char* command);
+    static std::unordered_map<std::string, std::string> StringMap(const redisReply* reply, const char* command);
+    static std::optional<std::pair<std::string, std::string>> OptionalStringPair(const redisReply* reply, const char* command);
+    /** [[id, [field, value ...]] ...] as XRANGE, XREADGROUP and XAUTOCLAIM return it */
+    static std::vector<RedisStreamEntry> StreamEntries(const redisReply* reply, const char* command);
+};
+
+template <typename T>
+using RedisConvertFunc = T (*)(const redisReply*, const char*);
+
+inline std::string RedisArgument(int64_t value) {
+    return std::to_string(value);
+}
+inline std::string RedisArgument(double value) {
+    char buffer[32];
+    auto [end, ec] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, end);
+}
+/** appends argv to buffer as one RESP request, for front ends that write raw batches to the socket */
+void RedisAppendCommand(std::string& buffer, const std::string_view* argv, size_t argc);
+inline void RedisAppendCommand(std::string& buffer, std::initializer_list<std::string_view> argv) {
+    RedisAppendCommand(buffer, argv.begin(), argv.size());
+}
+
+template <typename T>
+struct RedisIsOptional : std::false_type {};
+template <typename T>
+struct RedisIsOptional<std::optional<T>> : std::true_type {};
+
+/**
+ * @brief text form of the members hset_object / hget_object map to hash fields.
+ *        strings are sent as they are, numbers, bools and enums in their shortest decimal form,
+ *        an empty optional is not written and a missing field reads back as an empty optional
+ */
+struct RedisFieldCodec {
+    using Buffer = std::array<char, 32>;
+    /** the text of value, numbers are printed into buffer, nullopt for an empty optional */
+    template <typename T>
+    static std::optional<std::string_view> Encode(const T& value, Buffer& buffer) {
+        if constexpr (RedisIsOptional<T>::value) {
+            return value ? Encode(*value, buffer) : std::nullopt;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            return std::string_view(value ? "1" : "0");
+        } else if constexpr (std::is_enum_v<T>) {
+            return Encode(static_cast<std::underlying_type_t<T>>(value), buffer);
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            auto [end, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+            return std::string_view(buffer.data(), end - buffer.data());
+        } else {
+            static_assert(std::is_convertible_v<const T&, std::string_view>, "hash field must be a string, a number, a bool, an enum or an optional of them");
+            return std::string_view(value);
+        }
+    }
+    /** false when text is not a valid T */
+    template <typename T>
+    static bool Decode(std::string_view text, T& value) {
+        if constexpr (RedisIsOptional<T>::value) {
+            typename T::value_type inner {};
+            if (!Decode(text, inner)) {
+                return false;
+            }
+            value = std::move(inner);
+            return true;
+        } else if constexpr (std::is_same_v<T, bool>) {
+            value = text == "1";
+            return text == "1" || text == "0";
+        } else if constexpr (std::is_enum_v<T>) {
+            std::underlying_type_t<T> number {};
+            if (!Decode(text, number)) {
+                return false;
+            }
+            value = static_cast<T>(number);
+            return true;
+        } else if constexpr (std::is_arithmetic_v<T>) {
+            auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return ec == std::errc() && end == text.data() + text.size();
+        } else {
+            static_assert(std::is_assignable_v<T&, std::string_view>, "hash field must be a string, a number, a bool, an enum or an optional of them");
+            value = text;
+            return true;
+        }
+    }
+    /** a field missing from the hash, only optionals are touched */
+    template <typename T>
+    static void Missing(T& value) {
+        if constexpr (RedisIsOptional<T>::value) {
+            value.reset();
+        }
+    }
+};
+
+template <typename T>
+bool RedisStreamEntry::Decode(T& object) const {
+    bool found = false;
+    visit_fields(object, [this, &found](const char* name, auto& member) {
+        auto it = std::find_if(fields.begin(), fields.end(), [name](const auto& field) { return field.first == name; });
+        if (it == fields.end()) {
+            RedisFieldCodec::Missing(member);
+            return;
+        }
+        found = true;
+        if (!RedisFieldCodec::Decode(it->second, member)) {
+            throw std::runtime_error("redis stream entry " + id + " can not parse field " + std::string(name));
+        }
+    });
+    return found;
+}
+
+class RedisPipeline;
+class RedisReplyArena;
+class RedisScanCursor;
+template <typename T>
+class RedisScanRange;
 class RedisClient {
+    friend class RedisPipeline;
+    friend class RedisTransaction;
+    friend class RedisScanCursor;
+    friend class RedisNearCache;
+    friend class RedisConnectPool;
+    friend class RedisBulkLoader;
+    friend class RedisSubscriber;
 public:
     using Ptr = std::shared_ptr<RedisClient>;
     static RedisClient::Ptr Create(const std::string& ip = "127.0.0.1"
@@ -51,6 +284,7 @@ public:
     RedisClient();
     RedisClient(const std::string& ip, const uint16_t port, const std::string& password = "");
 
+    /** reconnects on the same context and authenticates again */
     bool Reconnect();
     bool Connect();
     bool Connect(const std::string& ip, const uint16_t port, const std::string& password = "");
@@ -58,9 +292,31 @@ public:
     bool ConnectWithTimeout(const std::string& ip, const uint16_t port, uint64_t ms, const std::string& password = "");
     void SetPassword(const std::string& password);
     std::string GetPassword() const;
+    /**
+     * build replies in a per connection bump arena instead of one malloc per element,
+     * kept across Reconnect. replies must still be freed through RedisReplyPtr
+     */
+    void EnableReplyArena(size_t blockSize = 64 * 1024);
+    /** hiredis leaves a context unusable once an error (REDIS_ERR_IO, REDIS_ERR_EOF ...) was recorded on it */
+    bool IsBroken() const { return !m_context || m_context->err != 0; }
+    /** round trip to the server, false when the connection does not answer PONG */
+    bool Ping();
 
     RedisReplyPtr Command(const char* fmt, ...);
     RedisReplyPtr Command(const char* fmt, va_list ap);
+    /** binary safe, every element is sent as one argument without formatting */
+    RedisReplyPtr CommandArgv(const std::vector<std::string_view>& argv);
+    /** CommandArgv that throws on a lost connection or an error reply and keeps the reply alive in a view */
+    RedisReplyView CommandView(const std::vector<std::string_view>& argv);
+
+    /** zero copy reads, the returned view owns the reply */
+    /** GET             */ RedisReplyView get_view(const std::string& key);
+    /** MGET            */ RedisReplyView mget_view(const std::vector<std::string>& keys);
+    /** HGETALL         */ RedisReplyView hgetall_view(const std::string& key);
+    /** HMGET           */ RedisReplyView hmget_view(const std::string& key, const std::vector<std::string>& fields);
+    /** LRANGE          */ RedisReplyView lrange_view(const std::string& key, long long start, long long stop);
+    /** SMEMBERS        */ RedisReplyView smembers_view(const std::string& key);
+    /** ZRANGE          */ RedisReplyView zrange_view(const std::string& key, int start, int stop, bool withScores = false);
 
     /** key             */
     /** DEL             */ int32_t del(const std::string& key);
@@ -78,6 +334,7 @@ public:
     /** RANDOMKEY       */ std::optional<std::string> randonkey();
     /** RENAME          */ bool rename(const std::string& old_key, const std::string& new_key);
     /** RENAMENX        */ bool renamenx(const std::string& old_key, const std::string& new_key);
+    /** SCAN            */ RedisScanRange<std::string> scan(const std::string& pattern = "*", size_t count = 100, bool prefetch = false);
     /** TYPE            */ RedisDataType type(const std::string& key);
 
     /** string          */
@@ -111,9 +368,20 @@ public:
     /** HLEN            */ int64_t hlen(const std::string& key);
     /** HMGET           */ std::vector<std::optional<std::string>> hmget(const std::string& key, const std::vector<std::string>& fields);
     /** HMSET           */ bool hmset(const std::string& key, const std::unordered_map<std::string, std::string>& values);
+    /** HSCAN           */ RedisScanRange<std::pair<std::string, std::string>> hscan(const std::string& key, const std::string& pattern = "*", size_t count = 100, bool prefetch = false);
     /** HSET            */ bool hset(const std::string& key, const std::string& field, const std::string& value);
     /** HSETNX          */ bool hsetnx(const std::string& key, const std::string& field, const std::string& value);
     /** HVALS           */ std::vector<std::string> hvals(const std::string& key);
+    /**
+     * objects whose members are listed by RAPIDJSON_REFLECTION_PARSE, every member is one hash field.
+     * the argv points into the object itself, no map or json is built in between
+     */
+    /** HSET            */ template <typename T> int64_t hset_object(const std::string& key, const T& object);
+    /** HMGET           */ template <typename T> std::optional<T> hget_object(const std::string& key);
+    /** HMGET           */ template <typename T> bool hget_object(const std::string& key, T& object, const std::vector<std::string_view>& members = {});
+    /** objects listed by BYTE_ARRAY_REFLECTION (or RAPIDJSON_REFLECTION_PARSE) stored in their byte_array.h form */
+    /** SET             */ template <typename T> bool set_binary(const std::string& key, const T& object, int64_t ttl_ms = 0);
+    /** GET             */ template <typename T> std::optional<T> get_binary(const std::string& key);
 
     /** set             */
     /** SADD            */ bool sadd(const std::string& key, const std::vector<std::string>& members, int& addedCount);
@@ -128,6 +396,7 @@ public:
     /** SPOP            */ std::optional<std::string> spop(const std::string& key);
     /** SRANDMEMBER     */ std::vector<std::string> srandmember(const std::string& key, size_t count);
     /** SREM            */ bool srem(const std::string& key, const std::vector<std::string>& members, int& removedCount);
+    /** SSCAN           */ RedisScanRange<std::string> sscan(const std::string& key, const std::string& pattern = "*", size_t count = 100, bool prefetch = false);
     /** SUNION          */ std::vector<std::string> sunion(const std::vector<std::string>& keys);
     /** SUNIONSTORE     */ bool sunionstore(const std::string& destination, const std::vector<std::string>& keys);
 
@@ -148,6 +417,7 @@ public:
     /** ZREVRANGE       */ std::vector<std::string> zrevrange(const std::string& key, int start, int stop, bool withscores);
     /** ZREVRANGEBYSCORE*/ std::vector<std::string> zrevrangebyscore(const std::string& key, double maxScore, double minScore, bool withScores, int offset, int count);
     /** ZREVRANK        */ int64_t zrevrank(const std::string& key, const std::string& member);
+    /** ZSCAN           */ RedisScanRange<std::pair<std::string, double>> zscan(const std::string& key, const std::string& pattern = "*", size_t count = 100, bool prefetch = false);
     /** ZSCORE          */ std::optional<double> zscore(const std::string& key, const std::string& member);
     /** ZUNIONSTORE     */ bool zunionstore(const std::string& destination, const std::vector<std::string>& keys, const std::vector<double>& weights /* = {} */, const std::string& aggregate /* = "SUM" */);
 
@@ -169,68 +439,842 @@ public:
     /** RPOPLPUSH       */ std::string rpoplpush(const std::string& source, const std::string& destination);
     /** RPUSH           */ long long rpush(const std::string& key, const std::vector<std::string>& values);
     /** RPUSHX          */ long long rpushx(const std::string& key, const std::string& value);
+
+    /** stream          */
+    /** XACK            */ int64_t xack(const std::string& key, const std::string& group, const std::vector<std::string>& ids);
+    /** XADD            */ std::string xadd(const std::string& key, const std::vector<std::pair<std::string, std::string>>& fields, const std::string& id = "*");
+    /** XADD            */ template <typename T> std::string xadd_object(const std::string& key, const T& object);
+    /** XDEL            */ int64_t xdel(const std::string& key, const std::vector<std::string>& ids);
+    /** XGROUP CREATE   */ bool xgroup_create(const std::string& key, const std::string& group, const std::string& id = "$", bool mkstream = true);
+    /** XLEN            */ int64_t xlen(const std::string& key);
+    /** XRANGE          */ std::vector<RedisStreamEntry> xrange(const std::string& key, const std::string& start = "-", const std::string& end = "+", size_t count = 0);
+    /** XTRIM           */ int64_t xtrim(const std::string& key, size_t maxlen, bool approximate = true);
+
+    /** transaction     */
+    /** WATCH           */ bool watch(const std::vector<std::string>& keys);
+    /** UNWATCH         */ bool unwatch();
+private:
+    bool Auth();
+    void InstallArena();
+    RedisReplyPtr WrapReply(redisReply* reply) const;
+    /** appends name, text of every member that has a value to m_args, numbers are printed into m_numbers */
+    template <typename T>
+    void AppendObjectFields(const T& object);
+    /** runs m_args, parsed by the same converter the pipeline, transaction and coroutine front ends use */
+    template <typename T>
+    T Execute(RedisConvertFunc<T> convert) {
+        auto reply = CommandArgv(m_args);
+        return convert(reply.get(), m_args[0].data());
+    }
 private:
     std::string m_host;
     uint16_t m_port;
     std::string m_password;
+    std::shared_ptr<RedisReplyArena> m_arena;
     std::shared_ptr<redisContext> m_context;
+    /** scratch buffers reused by CommandArgv, a connection is never shared between threads */
+    std::vector<std::string_view> m_args;
+    std::vector<const char*> m_argv;
+    std::vector<size_t> m_argvlen;
+    std::vector<std::array<char, 32>> m_numbers;
+    std::string m_bytes;
+    /** RedisNearCache epoch this connection reports its reads to, 0 when it is not tracked */
+    uint64_t m_trackingEpoch = 0;
+};
+
+template <typename T>
+void RedisClient::AppendObjectFields(const T& object) {
+    size_t count = 0;
+    visit_fields(object, [&count](const char*, const auto&) { ++count; });
+    if (m_numbers.size() < count) {
+        m_numbers.resize(count);
+    }
+    size_t i = 0;
+    visit_fields(object, [this, &i](const char* name, const auto& member) {
+        if (auto text = RedisFieldCodec::Encode(member, m_numbers[i++])) {
+            m_args.emplace_back(name);
+            m_args.emplace_back(*text);
+        }
+    });
+}
+template <typename T>
+int64_t RedisClient::hset_object(const std::string& key, const T& object) {
+    m_args.assign({"HSET", key});
+    AppendObjectFields(object);
+    if (m_args.size() == 2) {
+        return 0;
+    }
+    return Execute(&RedisReplyConverter::Integer);
+}
+template <typename T>
+std::string RedisClient::xadd_object(const std::string& key, const T& object) {
+    m_args.assign({"XADD", key, "*"});
+    AppendObjectFields(object);
+    if (m_args.size() == 3) {
+        throw std::runtime_error("redis xadd_object without a member to write, key : " + key);
+    }
+    auto id = Execute(&RedisReplyConverter::OptionalString);
+    if (!id) {
+        throw std::runtime_error("Unexpected reply when executing XADD for key: " + key);
+    }
+    return *id;
+}
+template <typename T>
+bool RedisClient::set_binary(const std::string& key, const T& object, int64_t ttl_ms) {
+    m_bytes.clear();
+    ByteArrayConverter::serialise(object, m_bytes);
+    m_args.assign({"SET", key, m_bytes});
+    std::string ttl;
+    if (ttl_ms > 0) {
+        ttl = RedisArgument(ttl_ms);
+        m_args.insert(m_args.end(), {"PX", ttl});
+    }
+    auto reply = CommandArgv(m_args);
+    return RedisReplyConverter::Status(reply.get(), "SET");
+}
+template <typename T>
+std::optional<T> RedisClient::get_binary(const std::string& key) {
+    /** decoded straight from the reply buffer */
+    auto reply = get_view(key);
+    if (reply.IsNil()) {
+        return std::nullopt;
+    }
+    return ByteArrayConverter::deserialise<T>(reply.Str());
+}
+template <typename T>
+std::optional<T> RedisClient::hget_object(const std::string& key) {
+    T object {};
+    if (!hget_object(key, object)) {
+        return std::nullopt;
+    }
+    return object;
+}
+template <typename T>
+bool RedisClient::hget_object(const std::string& key, T& object, const std::vector<std::string_view>& members) {
+    auto selected = [&members](std::string_view name) {
+        return members.empty() || std::find(members.begin(), members.end(), name) != members.end();
+    };
+    m_args.assign({"HMGET", key});
+    visit_fields(object, [this, &selected](const char* name, const auto&) {
+        if (selected(name)) {
+            m_args.emplace_back(name);
+        }
+    });
+    if (m_args.size() == 2) {
+        throw std::runtime_error("redis hget_object without a member to read, key : " + key);
+    }
+    auto reply = CommandView(m_args);
+    if (reply.size() != m_args.size() - 2) {
+        throw std::runtime_error("Unexpected reply when executing HMGET for key: " + key);
+    }
+    /** the replies come in the order the members were asked for */
+    bool found = false;
+    size_t i = 0;
+    visit_fields(object, [&](const char* name, auto& member) {
+        if (!selected(name)) {
+            return;
+        }
+        auto index = i++;
+        if (reply.IsNil(index)) {
+            RedisFieldCodec::Missing(member);
+            return;
+        }
+        found = true;
+        if (!RedisFieldCodec::Decode(reply[index], member)) {
+            throw std::runtime_error("redis hget_object can not parse field " + std::string(name) + " of key : " + key);
+        }
+    });
+    return found;
+}
+
+/**
+ * @brief pages of one SCAN family iteration (SCAN, SSCAN, HSCAN, ZSCAN), memory is bounded by the COUNT hint.
+ *        with prefetch the next page is requested as soon as a page arrives, so the server works on it
+ *        while the caller consumes the current one. the request is outstanding on the connection,
+ *        do not send other commands on the same RedisClient until the iteration is finished or dropped
+ */
+class RedisScanCursor {
+public:
+    RedisScanCursor(RedisClient& client, std::vector<std::string> command
+        , const std::string& pattern, size_t count, bool prefetch);
+    RedisScanCursor(const RedisScanCursor&) = delete;
+    RedisScanCursor& operator=(const RedisScanCursor&) = delete;
+    /** reads a prefetched page nobody asked for, the connection stays in step */
+    ~RedisScanCursor();
+    /** next page, the elements are replaced, false once the cursor came back to 0 */
+    bool Next(std::vector<std::string>& elements);
+    bool Next(std::vector<std::pair<std::string, std::string>>& elements);
+    bool Next(std::vector<std::pair<std::string, double>>& elements);
+private:
+    /** element array of the next page, null when the iteration is over */
+    const redisReply* Fetch();
+    void Request();
+private:
+    RedisClient& m_client;
+    std::vector<std::string> m_command;
+    size_t m_cursorIndex;
+    bool m_prefetch;
+    bool m_pending = false;
+    bool m_done = false;
+    RedisReplyPtr m_page;
+};
+
+/**
+ * @brief lazy input range over a SCAN family iteration, e.g.
+ *        for (auto& key : client.scan("user:*", 1000)) { ... }
+ *        a key may be returned more than once, SCAN only guarantees keys present for the whole iteration
+ */
+template <typename T>
+class RedisScanRange {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+        explicit Iterator(RedisScanRange* range = nullptr) : m_range (range) {}
+        const T& operator*() const { return m_range->m_page[m_range->m_index]; }
+        const T* operator->() const { return &m_range->m_page[m_range->m_index]; }
+        Iterator& operator++() {
+            if (!m_range->Advance()) {
+                m_range = nullptr;
+            }
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return m_range == other.m_range; }
+        bool operator!=(const Iterator& other) const { return m_range != other.m_range; }
+    private:
+        RedisScanRange* m_range;
+    };
+
+    RedisScanRange(RedisClient& client, std::vector<std::string> command
+        , const std::string& pattern, size_t count, bool prefetch)
+        : m_cursor (std::make_unique<RedisScanCursor>(client, std::move(command), pattern, count, prefetch)) {
+    }
+    /** single pass, begin() may be called once */
+    Iterator begin() {
+        m_index = 0;
+        m_page.clear();
+        while (m_page.empty()) {
+            if (!m_cursor->Next(m_page)) {
+                return end();
+            }
+        }
+        return Iterator(this);
+    }
+    Iterator end() { return Iterator(); }
+private:
+    bool Advance() {
+        if (++m_index < m_page.size()) {
+            return true;
+        }
+        /** a page may be empty while the iteration goes on */
+        m_index = 0;
+        do {
+            if (!m_cursor->Next(m_page)) {
+                return false;
+            }
+        } while (m_page.empty());
+        return true;
+    }
+private:
+    std::unique_ptr<RedisScanCursor> m_cursor;
+    std::vector<T> m_page;
+    size_t m_index = 0;
+};
+
+/**
+ * @brief typed command surface shared by the non-blocking front ends
+ *        Derived implements Submit<T>(convert, argv, argc) and decides what is returned
+ *        (a future for pipelines, an awaitable for coroutines ...)
+ */
+template <typename Derived>
+class RedisCommands {
+public:
+    /** key             */
+    /** DEL             */ auto del(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"DEL", key}); }
+    /** DUMP            */ auto dump(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"DUMP", key}); }
+    /** EXISTS          */ auto exists(const std::string& key) { return Invoke(&RedisReplyConverter::Boolean, {"EXISTS", key}); }
+    /** Expire          */ auto expire(const std::string& key, const int64_t seconds) { return Invoke(&RedisReplyConverter::Boolean, {"EXPIRE", key, RedisArgument(seconds)}); }
+    /** EXPIREAT        */ auto expireat(const std::string& key, const int64_t unix_timestamp) { return Invoke(&RedisReplyConverter::Boolean, {"EXPIREAT", key, RedisArgument(unix_timestamp)}); }
+    /** PEXPIRE         */ auto pexpire(const std::string& key, const int64_t milliseconds) { return Invoke(&RedisReplyConverter::Boolean, {"PEXPIRE", key, RedisArgument(milliseconds)}); }
+    /** PEXPIREAT       */ auto pexpireat(const std::string& key, const int64_t milliseconds_timestamp) { return Invoke(&RedisReplyConverter::Boolean, {"PEXPIREAT", key, RedisArgument(milliseconds_timestamp)}); }
+    /** KEYS            */ auto keys(const std::string& pattern) { return Invoke(&RedisReplyConverter::StringArray, {"KEYS", pattern}); }
+    /** MOVE            */ auto move(const std::string& key, const int32_t destination_database) { return Invoke(&RedisReplyConverter::Boolean, {"MOVE", key, RedisArgument(int64_t(destination_database))}); }
+    /** PERSIST         */ auto persist(const std::string& key) { return Invoke(&RedisReplyConverter::Boolean, {"PERSIST", key}); }
+    /** PTTL            */ auto pttl(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"PTTL", key}); }
+    /** TTL             */ auto ttl(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"TTL", key}); }
+    /** RANDOMKEY       */ auto randomkey() { return Invoke(&RedisReplyConverter::OptionalString, {"RANDOMKEY"}); }
+    /** RENAME          */ auto rename(const std::string& old_key, const std::string& new_key) { return Invoke(&RedisReplyConverter::Status, {"RENAME", old_key, new_key}); }
+    /** RENAMENX        */ auto renamenx(const std::string& old_key, const std::string& new_key) { return Invoke(&RedisReplyConverter::Boolean, {"RENAMENX", old_key, new_key}); }
+    /** TYPE            */ auto type(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"TYPE", key}); }
+
+    /** string          */
+    /** SET             */ auto set(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::Status, {"SET", key, value}); }
+    /** GET             */ auto get(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"GET", key}); }
+    /** GETRANGE        */ auto getrange(const std::string& key, int32_t start, int32_t end) { return Invoke(&RedisReplyConverter::OptionalString, {"GETRANGE", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(end))}); }
+    /** GETSET          */ auto getset(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::OptionalString, {"GETSET", key, value}); }
+    /** GETBIT          */ auto getbit(const std::string& key, int32_t offset) { return Invoke(&RedisReplyConverter::OptionalInteger, {"GETBIT", key, RedisArgument(int64_t(offset))}); }
+    /** MGET            */ auto mget(const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::OptionalStringArray, {"MGET"}, keys); }
+    /** SETBIT          */ auto setbit(const std::string& key, int32_t offset, int32_t bit) { return Invoke(&RedisReplyConverter::Integer, {"SETBIT", key, RedisArgument(int64_t(offset)), RedisArgument(int64_t(bit))}); }
+    /** SETEX           */ auto setex(const std::string& key, int32_t seconds, const std::string& value) { return Invoke(&RedisReplyConverter::Status, {"SETEX", key, RedisArgument(int64_t(seconds)), value}); }
+    /** SETNX           */ auto setnx(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::Boolean, {"SETNX", key, value}); }
+    /** SETRANGE        */ auto setrange(const std::string& key, int32_t offset, const std::string& value) { return Invoke(&RedisReplyConverter::Integer, {"SETRANGE", key, RedisArgument(int64_t(offset)), value}); }
+    /** STRLEN          */ auto strlen(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalInteger, {"STRLEN", key}); }
+    /** MSET            */ auto mset(const std::vector<std::pair<std::string, std::string>>& values) {
+        std::vector<std::string_view> argv {"MSET"};
+        argv.reserve(values.size() * 2 + 1);
+        for (const auto& [key, value] : values) {
+            argv.emplace_back(key);
+            argv.emplace_back(value);
+        }
+        return Self().Submit(&RedisReplyConverter::Status, argv.data(), argv.size());
+    }
+    /** INCR            */ auto incr(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"INCR", key}); }
+    /** INCRBY          */ auto incrby(const std::string& key, int64_t increment) { return Invoke(&RedisReplyConverter::Integer, {"INCRBY", key, RedisArgument(increment)}); }
+    /** INCRBYFLOAT     */ auto incrbyfloat(const std::string& key, double increment) { return Invoke(&RedisReplyConverter::Double, {"INCRBYFLOAT", key, RedisArgument(increment)}); }
+    /** DECR            */ auto decr(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"DECR", key}); }
+    /** DECRBY          */ auto decrby(const std::string& key, int64_t decrement) { return Invoke(&RedisReplyConverter::Integer, {"DECRBY", key, RedisArgument(decrement)}); }
+    /** APPEND          */ auto append(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::Integer, {"APPEND", key, value}); }
+
+    /** hash            */
+    /** HDEL            */ auto hdel(const std::string& key, const std::vector<std::string>& fields) { return InvokeWith(&RedisReplyConverter::Boolean, {"HDEL", key}, fields); }
+    /** HEXISTS         */ auto hexists(const std::string& key, const std::string& field) { return Invoke(&RedisReplyConverter::Boolean, {"HEXISTS", key, field}); }
+    /** HGET            */ auto hget(const std::string& key, const std::string& field) { return Invoke(&RedisReplyConverter::OptionalString, {"HGET", key, field}); }
+    /** HGETALL         */ auto hgetall(const std::string& key) { return Invoke(&RedisReplyConverter::StringMap, {"HGETALL", key}); }
+    /** HINCRBY         */ auto hincrby(const std::string& key, const std::string& field, int64_t increment) { return Invoke(&RedisReplyConverter::Integer, {"HINCRBY", key, field, RedisArgument(increment)}); }
+    /** HINCRBYFLOAT    */ auto hincrbyfloat(const std::string& key, const std::string& field, double increment) { return Invoke(&RedisReplyConverter::Double, {"HINCRBYFLOAT", key, field, RedisArgument(increment)}); }
+    /** HKEYS           */ auto hkeys(const std::string& key) { return Invoke(&RedisReplyConverter::StringArray, {"HKEYS", key}); }
+    /** HLEN            */ auto hlen(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"HLEN", key}); }
+    /** HMGET           */ auto hmget(const std::string& key, const std::vector<std::string>& fields) { return InvokeWith(&RedisReplyConverter::OptionalStringArray, {"HMGET", key}, fields); }
+    /** HMSET           */ auto hmset(const std::string& key, const std::unordered_map<std::string, std::string>& values) {
+        std::vector<std::string_view> argv {"HMSET", key};
+        argv.reserve(values.size() * 2 + 2);
+        for (const auto& [field, value] : values) {
+            argv.emplace_back(field);
+            argv.emplace_back(value);
+        }
+        return Self().Submit(&RedisReplyConverter::Status, argv.data(), argv.size());
+    }
+    /** HSET            */ auto hset(const std::string& key, const std::string& field, const std::string& value) { return Invoke(&RedisReplyConverter::Boolean, {"HSET", key, field, value}); }
+    /** HSETNX          */ auto hsetnx(const std::string& key, const std::string& field, const std::string& value) { return Invoke(&RedisReplyConverter::Boolean, {"HSETNX", key, field, value}); }
+    /** HVALS           */ auto hvals(const std::string& key) { return Invoke(&RedisReplyConverter::StringArray, {"HVALS", key}); }
+
+    /** set             */
+    /** SADD            */ auto sadd(const std::string& key, const std::vector<std::string>& members) { return InvokeWith(&RedisReplyConverter::Integer, {"SADD", key}, members); }
+    /** SCARD           */ auto scard(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"SCARD", key}); }
+    /** SDIFF           */ auto sdiff(const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::StringArray, {"SDIFF"}, keys); }
+    /** SDIFFSTORE      */ auto sdiffstore(const std::string& destination, const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::Integer, {"SDIFFSTORE", destination}, keys); }
+    /** SINTER          */ auto sinter(const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::StringArray, {"SINTER"}, keys); }
+    /** SINTERSTORE     */ auto sinterstore(const std::string& destination, const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::Integer, {"SINTERSTORE", destination}, keys); }
+    /** SISMEMBER       */ auto sismember(const std::string& key, const std::string& member) { return Invoke(&RedisReplyConverter::Boolean, {"SISMEMBER", key, member}); }
+    /** SMEMBERS        */ auto smembers(const std::string& key) { return Invoke(&RedisReplyConverter::StringArray, {"SMEMBERS", key}); }
+    /** SMOVE           */ auto smove(const std::string& source, const std::string& destination, const std::string& member) { return Invoke(&RedisReplyConverter::Boolean, {"SMOVE", source, destination, member}); }
+    /** SPOP            */ auto spop(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"SPOP", key}); }
+    /** SRANDMEMBER     */ auto srandmember(const std::string& key, size_t count) { return Invoke(&RedisReplyConverter::StringArray, {"SRANDMEMBER", key, RedisArgument(int64_t(count))}); }
+    /** SREM            */ auto srem(const std::string& key, const std::vector<std::string>& members) { return InvokeWith(&RedisReplyConverter::Integer, {"SREM", key}, members); }
+    /** SUNION          */ auto sunion(const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::StringArray, {"SUNION"}, keys); }
+    /** SUNIONSTORE     */ auto sunionstore(const std::string& destination, const std::vector<std::string>& keys) { return InvokeWith(&RedisReplyConverter::Integer, {"SUNIONSTORE", destination}, keys); }
+
+    /** sorted set      */
+    /** ZADD            */ auto zadd(const std::string& key, const std::vector<std::pair<std::string, double>>& membersWithScores) {
+        std::vector<std::string> scores;
+        std::vector<std::string_view> argv {"ZADD", key};
+        scores.reserve(membersWithScores.size());
+        argv.reserve(membersWithScores.size() * 2 + 2);
+        for (const auto& [member, score] : membersWithScores) {
+            argv.emplace_back(scores.emplace_back(RedisArgument(score)));
+            argv.emplace_back(member);
+        }
+        return Self().Submit(&RedisReplyConverter::Integer, argv.data(), argv.size());
+    }
+    /** ZCARD           */ auto zcard(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"ZCARD", key}); }
+    /** ZCOUNT          */ auto zcount(const std::string& key, double minScore, double maxScore) { return Invoke(&RedisReplyConverter::Integer, {"ZCOUNT", key, RedisArgument(minScore), RedisArgument(maxScore)}); }
+    /** ZINCRBY         */ auto zincrby(const std::string& key, double increment, const std::string& member) { return Invoke(&RedisReplyConverter::Double, {"ZINCRBY", key, RedisArgument(increment), member}); }
+    /** ZLEXCOUNT       */ auto zlexcount(const std::string& key, const std::string& minMember, const std::string& maxMember) { return Invoke(&RedisReplyConverter::Integer, {"ZLEXCOUNT", key, minMember, maxMember}); }
+    /** ZRANGE          */ auto zrange(const std::string& key, int start, int stop) { return Invoke(&RedisReplyConverter::StringArray, {"ZRANGE", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(stop))}); }
+    /** ZRANGEBYLEX     */ auto zrangebylex(const std::string& key, const std::string& minLex, const std::string& maxLex) { return Invoke(&RedisReplyConverter::StringArray, {"ZRANGEBYLEX", key, minLex, maxLex}); }
+    /** ZRANGEBYSCORE   */ auto zrangebyscore(const std::string& key, double minScore, double maxScore) { return Invoke(&RedisReplyConverter::StringArray, {"ZRANGEBYSCORE", key, RedisArgument(minScore), RedisArgument(maxScore)}); }
+    /** ZRANK           */ auto zrank(const std::string& key, const std::string& member) { return Invoke(&RedisReplyConverter::Integer, {"ZRANK", key, member}); }
+    /** ZREM            */ auto zrem(const std::string& key, const std::vector<std::string>& members) { return InvokeWith(&RedisReplyConverter::Integer, {"ZREM", key}, members); }
+    /** ZREMRANGEBYLEX  */ auto zremrangebylex(const std::string& key, const std::string& minLex, const std::string& maxLex) { return Invoke(&RedisReplyConverter::Integer, {"ZREMRANGEBYLEX", key, minLex, maxLex}); }
+    /** ZREMRANGEBYRANK */ auto zremrangebyrank(const std::string& key, int start, int stop) { return Invoke(&RedisReplyConverter::Integer, {"ZREMRANGEBYRANK", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(stop))}); }
+    /** ZREMRANGEBYSCORE*/ auto zremrangebyscore(const std::string& key, double minScore, double maxScore) { return Invoke(&RedisReplyConverter::Integer, {"ZREMRANGEBYSCORE", key, RedisArgument(minScore), RedisArgument(maxScore)}); }
+    /** ZREVRANGE       */ auto zrevrange(const std::string& key, int start, int stop) { return Invoke(&RedisReplyConverter::StringArray, {"ZREVRANGE", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(stop))}); }
+    /** ZREVRANGEBYSCORE*/ auto zrevrangebyscore(const std::string& key, double maxScore, double minScore) { return Invoke(&RedisReplyConverter::StringArray, {"ZREVRANGEBYSCORE", key, RedisArgument(maxScore), RedisArgument(minScore)}); }
+    /** ZREVRANK        */ auto zrevrank(const std::string& key, const std::string& member) { return Invoke(&RedisReplyConverter::Integer, {"ZREVRANK", key, member}); }
+    /** ZSCORE          */ auto zscore(const std::string& key, const std::string& member) { return Invoke(&RedisReplyConverter::OptionalDouble, {"ZSCORE", key, member}); }
+
+    /** list            */
+    /** BLPOP           */ auto blpop(const std::vector<std::string>& keys, int timeout) { return InvokeWith(&RedisReplyConverter::OptionalStringPair, {"BLPOP"}, keys, {RedisArgument(int64_t(timeout))}); }
+    /** BRPOP           */ auto brpop(const std::vector<std::string>& keys, int timeout) { return InvokeWith(&RedisReplyConverter::OptionalStringPair, {"BRPOP"}, keys, {RedisArgument(int64_t(timeout))}); }
+    /** BRPOPLPUSH      */ auto brpoplpush(const std::string& source, const std::string& destination, int timeout) { return Invoke(&RedisReplyConverter::OptionalString, {"BRPOPLPUSH", source, destination, RedisArgument(int64_t(timeout))}); }
+    /** LINDEX          */ auto lindex(const std::string& key, long long index) { return Invoke(&RedisReplyConverter::OptionalString, {"LINDEX", key, RedisArgument(int64_t(index))}); }
+    /** LINSERT         */ auto linsert(const std::string& key, const std::string& pivot, const std::string& value, bool before) { return Invoke(&RedisReplyConverter::Integer, {"LINSERT", key, before ? "BEFORE" : "AFTER", pivot, value}); }
+    /** LLEN            */ auto llen(const std::string& key) { return Invoke(&RedisReplyConverter::Integer, {"LLEN", key}); }
+    /** LPOP            */ auto lpop(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"LPOP", key}); }
+    /** LPUSH           */ auto lpush(const std::string& key, const std::vector<std::string>& values) { return InvokeWith(&RedisReplyConverter::Integer, {"LPUSH", key}, values); }
+    /** LPUSHX          */ auto lpushx(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::Integer, {"LPUSHX", key, value}); }
+    /** LRANGE          */ auto lrange(const std::string& key, long long start, long long stop) { return Invoke(&RedisReplyConverter::StringArray, {"LRANGE", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(stop))}); }
+    /** LREM            */ auto lrem(const std::string& key, int count, const std::string& value) { return Invoke(&RedisReplyConverter::Integer, {"LREM", key, RedisArgument(int64_t(count)), value}); }
+    /** LSET            */ auto lset(const std::string& key, long long index, const std::string& value) { return Invoke(&RedisReplyConverter::Status, {"LSET", key, RedisArgument(int64_t(index)), value}); }
+    /** LTRIM           */ auto ltrim(const std::string& key, long long start, long long stop) { return Invoke(&RedisReplyConverter::Status, {"LTRIM", key, RedisArgument(int64_t(start)), RedisArgument(int64_t(stop))}); }
+    /** RPOP            */ auto rpop(const std::string& key) { return Invoke(&RedisReplyConverter::OptionalString, {"RPOP", key}); }
+    /** RPOPLPUSH       */ auto rpoplpush(const std::string& source, const std::string& destination) { return Invoke(&RedisReplyConverter::OptionalString, {"RPOPLPUSH", source, destination}); }
+    /** RPUSH           */ auto rpush(const std::string& key, const std::vector<std::string>& values) { return InvokeWith(&RedisReplyConverter::Integer, {"RPUSH", key}, values); }
+    /** RPUSHX          */ auto rpushx(const std::string& key, const std::string& value) { return Invoke(&RedisReplyConverter::Integer, {"RPUSHX", key, value}); }
+protected:
+    Derived& Self() { return static_cast<Derived&>(*this); }
+    template <typename T>
+    auto Invoke(RedisConvertFunc<T> convert, std::initializer_list<std::string_view> argv) {
+        return Self().Submit(convert, argv.begin(), argv.size());
+    }
+    template <typename T>
+    auto InvokeWith(RedisConvertFunc<T> convert, std::initializer_list<std::string_view> head
+        , const std::vector<std::string>& middle, std::initializer_list<std::string_view> tail = {}) {
+        std::vector<std::string_view> argv(head);
+        argv.reserve(head.size() + middle.size() + tail.size());
+        argv.insert(argv.end(), middle.begin(), middle.end());
+        argv.insert(argv.end(), tail.begin(), tail.end());
+        return Self().Submit(convert, argv.data(), argv.size());
+    }
+};
+
+/**
+ * @brief queue commands on one connection and flush them with a single write
+ *        every typed call returns a future which is fulfilled by Exec().
+ *        a pipeline dropped before Exec does no I/O, its futures fail and the connection is left broken
+ *        (IsBroken), since the replies of the queued commands would otherwise reach its next user
+ */
+class RedisPipeline final : public RedisCommands<RedisPipeline> {
+    friend class RedisCommands<RedisPipeline>;
+public:
+    explicit RedisPipeline(RedisClient::Ptr client);
+    ~RedisPipeline();
+
+    std::future<RedisReplyPtr> Command(const std::vector<std::string_view>& argv);
+    /** writes the queued commands without reading, lets several pipelines be in flight before Exec */
+    bool Flush();
+    size_t Exec();
+    size_t PendingSize() const { return m_callbacks.size(); }
+protected:
+    template <typename T>
+    std::future<T> Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto future = promise->get_future();
+        const char* command = argv[0].data();
+        Append(argv, argc, [promise, convert, command](RedisReplyPtr reply) {
+            try {
+                promise->set_value(convert(reply.get(), command));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+private:
+    void Append(const std::string_view* argv, size_t argc, std::function<void(RedisReplyPtr)> callback);
+private:
+    RedisClient::Ptr m_client;
+    std::vector<const char*> m_argv;
+    std::vector<size_t> m_argvlen;
+    std::vector<std::function<void(RedisReplyPtr)>> m_callbacks;
+};
+
+/**
+ * @brief MULTI ... EXEC built from typed calls, every typed call returns a future which is fulfilled by Exec().
+ *        nothing is sent before Exec, which writes MULTI, the queued commands and EXEC at once and reads
+ *        every reply in that one round trip. until then the connection may still serve the reads a WATCH guards.
+ *        a transaction dropped without Exec sends nothing, its futures report a broken promise
+ */
+class RedisTransaction final : public RedisCommands<RedisTransaction> {
+    friend class RedisCommands<RedisTransaction>;
+public:
+    explicit RedisTransaction(RedisClient::Ptr client);
+
+    /** false when a watched key changed and nothing ran, the futures then hold an exception.
+     *  a command the server refuses to queue aborts the whole transaction and throws */
+    bool Exec();
+    size_t QueuedSize() const { return m_callbacks.size(); }
+protected:
+    template <typename T>
+    std::future<T> Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto future = promise->get_future();
+        const char* command = argv[0].data();
+        Append(argv, argc, [promise, convert, command](const redisReply* reply, const char* failure) {
+            try {
+                if (failure) {
+                    throw std::runtime_error(std::string("redis transaction error, command : ") + command + ", error message : " + failure);
+                }
+                promise->set_value(convert(reply, command));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+private:
+    using Callback = std::function<void(const redisReply* reply, const char* failure)>;
+    /** encodes the command in RESP behind the ones already queued */
+    void Append(const std::string_view* argv, size_t argc, Callback callback);
+    void Fail(std::vector<Callback>& callbacks, const char* failure);
+private:
+    RedisClient::Ptr m_client;
+    std::string m_buffer;
+    std::vector<Callback> m_callbacks;
+};
+
+/**
+ * @brief optimistic read-modify-write. WATCH keys, update(client, transaction) reads through the client and queues
+ *        its writes on the transaction, then EXEC. when a watched key changed in between it starts over, at most
+ *        attempts times. update returns false to give up without writing.
+ *        true once a transaction committed, false when update gave up or every attempt lost the race.
+ *        e.g. RedisWatch(client, {"stock"}, [](RedisClient& c, RedisTransaction& t) {
+ *                 auto left = std::stoll(c.get("stock").value_or("0"));
+ *                 if (left <= 0) return false;
+ *                 t.set("stock", std::to_string(left - 1));
+ *                 return true;
+ *             });
+ */
+template <typename F>
+bool RedisWatch(RedisClient::Ptr client, const std::vector<std::string>& keys, F&& update, size_t attempts = 8) {
+    for (size_t i = 0; i < attempts; ++i) {
+        client->watch(keys);
+        RedisTransaction transaction(client);
+        bool proceed = false;
+        try {
+            proceed = update(*client, transaction);
+        } catch (...) {
+            client->unwatch();
+            throw;
+        }
+        if (!proceed) {
+            client->unwatch();
+            return false;
+        }
+        /** EXEC unwatches whatever its outcome */
+        if (transaction.Exec()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** checkout statistics, bucket 0 of wait_histogram counts waits below 2 microseconds, bucket i > 0 those in [2^i, 2^(i+1)) */
+struct RedisConnectPoolStats {
+    uint64_t checkouts = 0;
+    uint64_t waits = 0;
+    uint64_t timeouts = 0;
+    uint64_t waiters = 0;
+    uint64_t peak_waiters = 0;
+    uint64_t opened = 0;
+    uint64_t reaped = 0;
+    uint64_t broken = 0;
+    uint64_t reconnects = 0;
+    /** connects that failed or threw, on demand, in the background and at Connect */
+    uint64_t connect_failures = 0;
+    /** master switches followed through sentinel */
+    uint64_t failovers = 0;
+    /** sentinel connects and queries that threw */
+    uint64_t sentinel_errors = 0;
+    std::array<uint64_t, 24> wait_histogram {};
+};
+
+/** strong reads go to the master, eventual reads may be served by a replica that lags behind */
+enum class RedisConsistency : int8_t {
+    strong,
+    eventual
+};
+
+enum class RedisReplicaBalance : int8_t {
+    round_robin,
+    /** the replica with the fewest connections checked out */
+    least_outstanding
+};
+
+/** true for commands that never write, those may be sent to a replica */
+bool RedisIsReadOnlyCommand(std::string_view command);
+
+struct RedisConnectPoolOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6379;
+    std::string password;
+    /** opened in parallel by Connect and never reaped */
+    size_t min_connections = 1;
+    /** further connections are opened on demand up to this bound */
+    size_t max_connections = std::thread::hardware_concurrency();
+    int64_t connect_timeout_ms = 50;
+    /** connections idle longer than this are closed down to min_connections, 0 keeps them forever */
+    int64_t idle_ttl_ms = 60 * 1000;
+    /** checkout PINGs a connection idle longer than this before handing it out, 0 never PINGs */
+    int64_t validate_idle_ms = 3 * 1000;
+    /** broken connections are reconnected in the background, the delay doubles per failed attempt */
+    int64_t reconnect_backoff_min_ms = 10;
+    int64_t reconnect_backoff_max_ms = 1000;
+    /** optional, receives the failures counted in the stats, called on the thread that hit them */
+    RedisErrorHandler error_handler;
+    /** read replicas of host:port, each gets a pool with the same settings */
+    std::vector<std::pair<std::string, uint16_t>> replicas;
+    RedisReplicaBalance replica_balance = RedisReplicaBalance::round_robin;
+    /** when set, host:port is asked from these sentinels and followed through +switch-master */
+    std::vector<std::pair<std::string, uint16_t>> sentinels;
+    std::string master_name;
+    std::string sentinel_password;
 };
 
 class RedisConnectPoolGuard;
+/**
+ * @brief elastic set of connections, checkout and return are a lock-free stack of slot indexes
+ *        the head packs a version tag with the index so a recycled slot can not be mistaken (ABA)
+ *        slots without a connection sit on a second stack and are connected on demand,
+ *        a maintenance thread closes connections idle longer than the ttl and reconnects broken ones.
+ *        when no connection can be had callers may wait, waiters are served in FIFO order and
+ *        a returned connection is handed to the oldest waiter directly.
+ *        with sentinels the pool follows failovers, connections to the old master are closed once
+ *        they are idle or returned and reopened against the new one, commands in flight finish first
+ */
 class RedisConnectPool final {
     friend class RedisConnectPoolGuard;
 public:
     using Ptr = std::shared_ptr<RedisConnectPool>;
     RedisConnectPool() {}
-    ~RedisConnectPool() {}
-    static RedisConnectPool::Ptr Instance() {
+    ~RedisConnectPool();
+    static const RedisConnectPool::Ptr& Instance() {
         static auto p = std::make_shared<RedisConnectPool>();
         return p;
     }
+    /** not thread safe, call before the pool is used */
+    void Connect(const RedisConnectPoolOptions& options);
     void Connect(const std::string& ip, const uint16_t port
-        , size_t count = std::thread::hardware_concurrency(), int64_t ms = 50, const std::string& password = "") {
-        count = count ? count : 1;
-        m_connections.resize(count ? count : 1);
-        for (auto i = 0; i < count; ++i) {
-            auto conn = std::make_shared<RedisClient>();
-            conn->ConnectWithTimeout(ip, port, ms, password);
-            m_connections.push_back(conn);
-            m_freeconnections.push_back(conn);
-        }
-    }
-    size_t ConnectPoolSize() const { return m_connections.size(); }
-    size_t FreeConnectionSize() const { return m_freeconnections.size(); }
+        , size_t count = std::thread::hardware_concurrency(), int64_t ms = 50, const std::string& password = "");
+    size_t ConnectPoolSize() const { return m_live.load(std::memory_order_relaxed); }
+    size_t MaxConnectPoolSize() const { return m_size; }
+    size_t FreeConnectionSize() const { return m_freeCount.load(std::memory_order_relaxed); }
+    RedisConnectPoolStats Stats() const;
+    /** pool to read from, the master itself for strong reads or when there is no replica */
+    RedisConnectPool* ReadPool(RedisConsistency consistency);
+    const std::vector<RedisConnectPool::Ptr>& Replicas() const { return m_replicas; }
+    /** "host:port" new connections go to */
+    std::string Endpoint() const;
+    /** moves the pool to another master, what sentinel does on +switch-master */
+    void Repoint(const std::string& host, uint16_t port);
 protected:
-    RedisClient::Ptr Get() {
-        std::lock_guard guard(m_mutex);
-        if (!m_freeconnections.size()) {
-            throw std::runtime_error("without redis connection");
+    /** slot index of a free connection, waits up to timeout, npos when none became free */
+    uint32_t Acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) {
+        m_checkouts.fetch_add(1, std::memory_order_relaxed);
+        /** free connections go to the waiters first, FIFO */
+        if (m_waiterCount.load() == 0) {
+            if (auto index = Pop(m_freeHead); index != npos) {
+                m_freeCount.fetch_sub(1, std::memory_order_relaxed);
+                return index;
+            }
+        }
+        /** the pool keeps growing while callers wait, a new connection goes to the oldest of them */
+        if (auto index = Grow(); index != npos) {
+            if (m_waiterCount.load() == 0) {
+                return index;
+            }
+            Release(index);
         }
-        auto conn = m_freeconnections.begin();
-        m_freeconnections.erase(m_freeconnections.begin());
-        return *conn;
+        return AcquireWait(timeout);
     }
-    void Return(RedisClient::Ptr conn) {
-        std::lock_guard guard(m_mutex);
-        m_freeconnections.push_back(conn);
+    /** Acquire and validate the connection, broken ones are passed to the background reconnect */
+    uint32_t Checkout(std::chrono::milliseconds timeout);
+    void Release(uint32_t index) {
+        if (m_slots[index].conn->IsBroken() || IsStale(index)) {
+            Discard(index);
+            return;
+        }
+        m_slots[index].lastUsed.store(NowMs(), std::memory_order_relaxed);
+        Push(m_freeHead, index);
+        m_freeCount.fetch_add(1, std::memory_order_relaxed);
+        if (m_waiterCount.load() != 0) {
+            HandOff();
+        }
     }
+    const RedisClient::Ptr& At(uint32_t index) const { return m_slots[index].conn; }
 private:
-    std::mutex m_mutex;
-    std::vector<RedisClient::Ptr> m_connections;
-    std::vector<RedisClient::Ptr> m_freeconnections;
+    static constexpr uint32_t npos = UINT32_MAX;
+    static uint64_t MakeHead(uint32_t tag, uint32_t index) { return (uint64_t)tag << 32 | index; }
+    static uint32_t HeadTag(uint64_t head) { return (uint32_t)(head >> 32); }
+    static uint32_t HeadIndex(uint64_t head) { return (uint32_t)head; }
+    static int64_t NowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    uint32_t Pop(std::atomic<uint64_t>& stack) {
+        auto head = stack.load();
+        while (true) {
+            auto index = HeadIndex(head);
+            if (index == npos) {
+                return npos;
+            }
+            auto next = m_slots[index].next.load(std::memory_order_relaxed);
+            if (stack.compare_exchange_weak(head, MakeHead(HeadTag(head) + 1, next))) {
+                return index;
+            }
+        }
+    }
+    void Push(std::atomic<uint64_t>& stack, uint32_t index) {
+        auto head = stack.load(std::memory_order_relaxed);
+        do {
+            m_slots[index].next.store(HeadIndex(head), std::memory_order_relaxed);
+        } while (!stack.compare_exchange_weak(head, MakeHead(HeadTag(head) + 1, index)));
+    }
+    bool IsStale(uint32_t index) const {
+        return m_slots[index].generation != m_generation.load(std::memory_order_acquire);
+    }
+    bool Open(uint32_t index);
+    uint32_t Grow();
+    uint32_t AcquireWait(std::chrono::milliseconds timeout);
+    void HandOff();
+    void RecordWait(std::chrono::steady_clock::duration waited);
+    void Discard(uint32_t index);
+    void Maintain();
+    void Reap();
+    void EndReaping();
+    void StopWorker();
+    /** master address from the first sentinel that knows it */
+    bool QueryMaster(std::string& host, uint16_t& port);
+    bool QueryMaster(const std::string& sentinelHost, uint16_t sentinelPort, std::string& host, uint16_t& port);
+    void WatchSentinels();
+    struct Slot {
+        RedisClient::Ptr conn;
+        /** master generation the connection was opened against */
+        uint64_t generation = 0;
+        std::atomic<uint32_t> next {npos};
+        std::atomic<int64_t> lastUsed {0};
+    };
+    struct Broken {
+        uint32_t index;
+        int64_t retryAt;
+        int64_t backoff;
+    };
+    struct Waiter {
+        std::condition_variable cond;
+        uint32_t index = npos;
+    };
+private:
+    RedisConnectPoolOptions m_options;
+    std::vector<RedisConnectPool::Ptr> m_replicas;
+    std::atomic<size_t> m_nextReplica {0};
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_size = 0;
+    alignas(64) std::atomic<uint64_t> m_freeHead {MakeHead(0, npos)};
+    alignas(64) std::atomic<size_t> m_freeCount {0};
+    alignas(64) std::atomic<size_t> m_waiterCount {0};
+    std::atomic<uint64_t> m_vacantHead {MakeHead(0, npos)};
+    std::atomic<size_t> m_live {0};
+    std::atomic<bool> m_reaping {false};
+    std::mutex m_reapMutex;
+    std::condition_variable m_reapCond;
+    std::mutex m_waitMutex;
+    std::deque<Waiter*> m_waiters;
+    std::atomic<int64_t> m_growAfter {0};
+    std::mutex m_workerMutex;
+    std::condition_variable m_workerCond;
+    bool m_workerStop = false;
+    std::vector<Broken> m_broken;
+    std::thread m_worker;
+    /** host and port change on failover, the generation with them */
+    mutable std::mutex m_endpointMutex;
+    std::atomic<uint64_t> m_generation {0};
+    std::thread m_sentinelWatcher;
+    RedisClient::Ptr m_sentinel;
+    std::atomic<uint64_t> m_checkouts {0};
+    std::atomic<uint64_t> m_waits {0};
+    std::atomic<uint64_t> m_timeouts {0};
+    std::atomic<uint64_t> m_peakWaiters {0};
+    std::atomic<uint64_t> m_opened {0};
+    std::atomic<uint64_t> m_reaped {0};
+    std::atomic<uint64_t> m_brokenCount {0};
+    std::atomic<uint64_t> m_reconnects {0};
+    std::atomic<uint64_t> m_connectFailures {0};
+    std::atomic<uint64_t> m_failovers {0};
+    std::atomic<uint64_t> m_sentinelErrors {0};
+    std::array<std::atomic<uint64_t>, 24> m_waitHistogram {};
 };
 
 class RedisConnectPoolGuard final {
 public:
+    RedisConnectPoolGuard() : m_pool (RedisConnectPool::Instance().get()) {}
+    /** checkout from a pool other than the process wide instance, the pool must outlive the guard */
+    explicit RedisConnectPoolGuard(RedisConnectPool* pool) : m_pool (pool) {}
+    /** eventual reads check out from a replica, falling back to the master when the replica has no connection */
+    explicit RedisConnectPoolGuard(RedisConsistency consistency)
+        : RedisConnectPoolGuard(RedisConnectPool::Instance().get(), consistency) {
+    }
+    RedisConnectPoolGuard(RedisConnectPool* pool, RedisConsistency consistency)
+        : m_pool (pool->ReadPool(consistency)), m_fallback (m_pool != pool ? pool : nullptr) {
+    }
+    RedisConnectPoolGuard(const RedisConnectPoolGuard&) = delete;
+    RedisConnectPoolGuard& operator=(const RedisConnectPoolGuard&) = delete;
     ~RedisConnectPoolGuard() {
-        RedisConnectPool::Instance()->Return(m_conn);
+        if (m_index != RedisConnectPool::npos) {
+            m_pool->Release(m_index);
+        }
     }
+    /** throws at once when every connection is checked out */
     RedisClient::Ptr Get() {
-        m_conn = RedisConnectPool::Instance()->Get();
+        return Get(std::chrono::milliseconds(0));
+    }
+    /** waits up to timeout for a connection before throwing */
+    RedisClient::Ptr Get(std::chrono::milliseconds timeout) {
+        if (m_index == RedisConnectPool::npos) {
+            m_index = m_pool->Checkout(timeout);
+            if (m_index == RedisConnectPool::npos && m_fallback) {
+                m_pool = m_fallback;
+                m_fallback = nullptr;
+                m_index = m_pool->Checkout(timeout);
+            }
+            if (m_index == RedisConnectPool::npos) {
+                throw std::runtime_error("without redis connection");
+            }
+            m_conn = m_pool->At(m_index);
+        }
         return m_conn;
     }
 private:
+    RedisConnectPool* m_pool;
+    RedisConnectPool* m_fallback = nullptr;
+    uint32_t m_index = RedisConnectPool::npos;
     RedisClient::Ptr m_conn;
 };
 
+/**
+ * @brief typed commands on a RedisConnectPool, every call checks out a connection for one command.
+ *        read only commands go to a replica unless the consistency asks for the master,
+ *        e.g. client.get(key) may read a replica, client.Strong().get(key) reads the master
+ */
+class RedisRoutingClient final : public RedisCommands<RedisRoutingClient> {
+    friend class RedisCommands<RedisRoutingClient>;
+public:
+    explicit RedisRoutingClient(RedisConnectPool::Ptr pool = RedisConnectPool::Instance()
+        , RedisConsistency consistency = RedisConsistency::eventual
+        , std::chrono::milliseconds timeout = std::chrono::milliseconds(100))
+        : m_pool (std::move(pool)), m_consistency (consistency), m_timeout (timeout) {
+    }
+    /** copy of this client for one call, e.g. client.Strong().get(key) right after a write */
+    RedisRoutingClient Strong() const { return RedisRoutingClient(m_pool, RedisConsistency::strong, m_timeout); }
+    RedisRoutingClient Eventual() const { return RedisRoutingClient(m_pool, RedisConsistency::eventual, m_timeout); }
+protected:
+    template <typename T>
+    T Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        auto consistency = RedisIsReadOnlyCommand(argv[0]) ? m_consistency : RedisConsistency::strong;
+        RedisReplyPtr reply;
+        {
+            RedisConnectPoolGuard guard(m_pool.get(), consistency);
+            reply = guard.Get(m_timeout)->CommandArgv(std::vector<std::string_view>(argv, argv + argc));
+        }
+        return convert(reply.get(), argv[0].data());
+    }
+private:
+    RedisConnectPool::Ptr m_pool;
+    RedisConsistency m_consistency;
+    std::chrono::milliseconds m_timeout;
+};
+
 #endif // ! ____REDIS_H____
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "redis_arena.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+/** in front of every root reply, lets FreeReply find the arena from the reply alone */
+struct alignas(16) RootHeader {
+    RedisReplyArena* arena;
+};
+}
+
+RedisReplyArena::RedisReplyArena(size_t blockSize, size_t retainSize)
+    : m_blockSize (blockSize), m_retainSize (retainSize) {
+}
+redisReplyObjectFunctions* RedisReplyArena::Functions() {
+    static redisReplyObjectFunctions functions {
+        &RedisReplyArena::CreateString,
+        &RedisReplyArena::CreateArray,
+        &RedisReplyArena::CreateInteger,
+        &RedisReplyArena::CreateDouble,
+        &RedisReplyArena::CreateNil,
+        &RedisReplyArena::CreateBool,
+        &RedisReplyArena::FreeReply
+    };
+    return &functions;
+}
+void RedisReplyArena::FreeReply(void* reply) {
+    if (!reply) {
+        return;
+    }
+    auto header = reinterpret_cast<RootHeader*>(static_cast<char*>(reply) - sizeof(RootHeader));
+    header->arena->Unref();
+}
+void RedisReplyArena::FreePush(void*, void* reply) {
+    FreeReply(reply);
+}
+void RedisReplyArena::Detach() {
+    Unref();
+}
+size_t RedisReplyArena::Capacity() const {
+    size_t capacity = 0;
+    for (auto& block : m_blocks) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+void* RedisReplyArena::Allocate(size_t size) {
+    size = (size + 15) & ~size_t(15);
+    while (m_block < m_blocks.size()) {
+        auto& block = m_blocks[m_block];
+        if (m_offset + size <= block.size) {
+            auto p = block.data.get() + m_offset;
+            m_offset += size;
+            return p;
+        }
+        ++m_block;
+        m_offset = 0;
+    }
+    auto blockSize = std::max(size, m_blockSize);
+    m_blocks.push_back({std::unique_ptr<char[]>(new char[blockSize]), blockSize});
+    m_block = m_blocks.size() - 1;
+    m_offset = size;
+    return m_blocks.back().data.get();
+}
+void RedisReplyArena::Rewind() {
+    /** keep what a typical reply needs, give back what one huge reply left behind */
+    size_t retained = 0;
+    size_t keep = 0;
+    while (keep < m_blocks.size() && (keep == 0 || retained + m_blocks[keep].size <= m_retainSize)) {
+        retained += m_blocks[keep].size;
+        ++keep;
+    }
+    m_blocks.resize(keep);
+    m_block = 0;
+    m_offset = 0;
+}
+void RedisReplyArena::Unref() {
+    if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+    }
+}
+redisReply* RedisReplyArena::CreateObject(const redisReadTask* task, int type) {
+    auto arena = static_cast<RedisReplyArena*>(task->privdata);
+    redisReply* reply;
+    if (!task->parent) {
+        /** a new reply starts, when none of the earlier ones is alive their memory is reused */
+        if (arena->m_refs.load(std::memory_order_acquire) == 1) {
+            arena->Rewind();
+        }
+        auto header = static_cast<RootHeader*>(arena->Allocate(sizeof(RootHeader) + sizeof(redisReply)));
+        header->arena = arena;
+        reply = reinterpret_cast<redisReply*>(header + 1);
+        arena->m_refs.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        reply = static_cast<redisReply*>(arena->Allocate(sizeof(redisReply)));
+        auto parent = static_cast<redisReply*>(task->parent->obj);
+        parent->element[task->idx] = reply;
+    }
+    std::memset(reply, 0, sizeof(redisReply));
+    reply->type = type;
+    return reply;
+}
+void* RedisReplyArena::CreateString(const redisReadTask* task, char* str, size_t len) {
+    auto arena = static_cast<RedisReplyArena*>(task->privdata);
+    auto reply = CreateObject(task, task->type);
+    if (task->type == REDIS_REPLY_VERB) {
+        /** verbatim string, "txt:" prefix goes to vtype like hiredis does */
+        std::memcpy(reply->vtype, str, 3);
+        reply->vtype[3] = '\0';
+        str += 4;
+        len -= 4;
+    }
+    auto buffer = static_cast<char*>(arena->Allocate(len + 1));
+    std::memcpy(buffer, str, len);
+    buffer[len] = '\0';
+    reply->str = buffer;
+    reply->len = len;
+    return reply;
+}
+void* RedisReplyArena::CreateArray(const redisReadTask* task, size_t elements) {
+    auto arena = static_cast<RedisReplyArena*>(task->privdata);
+    auto reply = CreateObject(task, task->type);
+    if (elements > 0) {
+        reply->element = static_cast<redisReply**>(arena->Allocate(elements * sizeof(redisReply*)));
+        std::memset(reply->element, 0, elements * sizeof(redisReply*));
+    }
+    reply->elements = elements;
+    return reply;
+}
+void* RedisReplyArena::CreateInteger(const redisReadTask* task, long long value) {
+    auto reply = CreateObject(task, REDIS_REPLY_INTEGER);
+    reply->integer = value;
+    return reply;
+}
+void* RedisReplyArena::CreateDouble(const redisReadTask* task, double value, char* str, size_t len) {
+    auto arena = static_cast<RedisReplyArena*>(task->privdata);
+    auto reply = CreateObject(task, REDIS_REPLY_DOUBLE);
+    reply->dval = value;
+    /** the textual form is kept as hiredis does, it is exact where the double is not */
+    auto buffer = static_cast<char*>(arena->Allocate(len + 1));
+    std::memcpy(buffer, str, len);
+    buffer[len] = '\0';
+    reply->str = buffer;
+    reply->len = len;
+    return reply;
+}
+void* RedisReplyArena::CreateNil(const redisReadTask* task) {
+    return CreateObject(task, REDIS_REPLY_NIL);
+}
+void* RedisReplyArena::CreateBool(const redisReadTask* task, int value) {
+    auto reply = CreateObject(task, REDIS_REPLY_BOOL);
+    reply->integer = value != 0;
+    return reply;
+}
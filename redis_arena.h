@@ -0,0 +1,71 @@
+/**
+ * @file redis_arena.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-05
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_ARENA_H____
+#define ____REDIS_ARENA_H____
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "hiredis.h"
+
+/**
+ * @brief bump allocator behind a redisReplyObjectFunctions table, replies of one connection are
+ *        built in a few large blocks instead of one malloc per element and string.
+ *        the blocks are rewound when a new reply starts and no earlier reply is alive any more,
+ *        so a connection reading one reply at a time reuses the same memory forever.
+ *        a reply may be released on any thread, the arena itself is only fed by its connection.
+ *        the arena is shared by its connection and every reply it built, the last one deletes it
+ */
+class RedisReplyArena final {
+public:
+    explicit RedisReplyArena(size_t blockSize = 64 * 1024, size_t retainSize = 4 * 1024 * 1024);
+    RedisReplyArena(const RedisReplyArena&) = delete;
+    RedisReplyArena& operator=(const RedisReplyArena&) = delete;
+
+    /** function table for redisReader::fn, the arena goes to redisReader::privdata */
+    static redisReplyObjectFunctions* Functions();
+    /** frees a reply built by an arena, the replacement of freeReplyObject */
+    static void FreeReply(void* reply);
+    /** redisPushFn dropping RESP3 push replies, hiredis' default handler would hand them to freeReplyObject */
+    static void FreePush(void* privdata, void* reply);
+    /** the owning connection lets go, the arena is deleted once its last reply is freed */
+    void Detach();
+
+    size_t BlockCount() const { return m_blocks.size(); }
+    size_t Capacity() const;
+private:
+    ~RedisReplyArena() = default;
+    void* Allocate(size_t size);
+    void Rewind();
+    void Unref();
+    static redisReply* CreateObject(const redisReadTask* task, int type);
+    static void* CreateString(const redisReadTask* task, char* str, size_t len);
+    static void* CreateArray(const redisReadTask* task, size_t elements);
+    static void* CreateInteger(const redisReadTask* task, long long value);
+    static void* CreateDouble(const redisReadTask* task, double value, char* str, size_t len);
+    static void* CreateNil(const redisReadTask* task);
+    static void* CreateBool(const redisReadTask* task, int value);
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+private:
+    size_t m_blockSize;
+    size_t m_retainSize;
+    std::vector<Block> m_blocks;
+    size_t m_block = 0;
+    size_t m_offset = 0;
+    /** one reference held by the connection plus one per live reply */
+    std::atomic<size_t> m_refs {1};
+};
+
+#endif // ! ____REDIS_ARENA_H____
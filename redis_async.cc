@@ -0,0 +1,237 @@
+#include "redis_async.h"
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+RedisAsyncClient::Ptr RedisAsyncClient::Create(const std::string& ip
+        , const uint16_t port, const std::string& password) {
+    auto redisClient = std::make_shared<RedisAsyncClient>(ip, port, password);
+    return redisClient;
+}
+RedisAsyncClient::RedisAsyncClient()
+    : RedisAsyncClient("", 0, "") {
+}
+RedisAsyncClient::RedisAsyncClient(const std::string& ip, const uint16_t port, const std::string& password)
+    : m_host (ip), m_port (port), m_password (password), m_context (nullptr), m_connectStatus (REDIS_ERR)
+    , m_authStatus (authOk), m_connected (false), m_running (false), m_epollfd (-1), m_wakeupfd (-1), m_socketfd (-1), m_events (0)
+    , m_callbackErrors (0) {
+}
+RedisAsyncClient::~RedisAsyncClient() {
+    Close();
+}
+bool RedisAsyncClient::Connect() {
+    return ConnectWithTimeout(m_host, m_port, 50, m_password);
+}
+bool RedisAsyncClient::ConnectWithTimeout(uint64_t ms) {
+    return ConnectWithTimeout(m_host, m_port, ms, m_password);
+}
+bool RedisAsyncClient::ConnectWithTimeout(const std::string& ip, const uint16_t port, uint64_t ms, const std::string& password) {
+    Close();
+    m_host = ip, m_port = port, m_password = password;
+
+    m_epollfd = epoll_create1(EPOLL_CLOEXEC);
+    m_wakeupfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epollfd < 0 || m_wakeupfd < 0) {
+        Close();
+        return false;
+    }
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = m_wakeupfd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_wakeupfd, &event);
+
+    std::unique_lock lock(m_mutex);
+    auto context = redisAsyncConnect(m_host.c_str(), m_port);
+    if (!context) {
+        lock.unlock();
+        Close();
+        return false;
+    }
+    if (context->err) {
+        redisAsyncFree(context);
+        lock.unlock();
+        Close();
+        return false;
+    }
+    m_context = context;
+    m_context->data = this;
+    m_socketfd = m_context->c.fd;
+    m_events = 0;
+    event.events = 0;
+    event.data.fd = m_socketfd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_ADD, m_socketfd, &event);
+
+    /** the event hooks must be installed before the connect callback, it arms the first write event */
+    m_context->ev.data = this;
+    m_context->ev.addRead = &RedisAsyncClient::AddRead;
+    m_context->ev.delRead = &RedisAsyncClient::DelRead;
+    m_context->ev.addWrite = &RedisAsyncClient::AddWrite;
+    m_context->ev.delWrite = &RedisAsyncClient::DelWrite;
+    m_context->ev.cleanup = &RedisAsyncClient::Cleanup;
+    m_connectStatus = REDIS_ERR;
+    redisAsyncSetConnectCallback(m_context, &RedisAsyncClient::OnConnect);
+    redisAsyncSetDisconnectCallback(m_context, &RedisAsyncClient::OnDisconnect);
+
+    m_authStatus = m_password.empty() ? authOk : authPending;
+
+    m_running = true;
+    m_thread = std::thread(&RedisAsyncClient::Loop, this);
+
+    if (!m_password.empty()) {
+        std::string_view argv[] = {"AUTH", m_password};
+        /** runs on the loop thread, which holds m_mutex while it handles replies */
+        Command(argv, 2, [this](redisReply* reply) {
+            bool ok = reply && reply->type == REDIS_REPLY_STATUS && reply->str && !strcmp("OK", reply->str);
+            m_authStatus = ok ? authOk : authFailed;
+            m_connectCond.notify_all();
+        });
+    }
+    /** connected only once AUTH is answered too, otherwise every later command would fail with NOAUTH */
+    auto done = m_connectCond.wait_for(lock, std::chrono::milliseconds(ms), [this]() {
+        return !m_context || (m_connected && m_authStatus != authPending);
+    });
+    if (done && m_connected && m_authStatus == authOk) {
+        return true;
+    }
+    bool rejected = done && m_connected && m_authStatus == authFailed;
+    lock.unlock();
+    Close();
+    if (rejected) {
+        throw std::runtime_error("auth error:( " + m_host + " : " + std::to_string(m_port));
+    }
+    return false;
+}
+void RedisAsyncClient::Close() {
+    {
+        std::lock_guard guard(m_mutex);
+        if (m_context) {
+            /** pending callbacks are invoked with a null reply */
+            auto context = m_context;
+            m_context = nullptr;
+            redisAsyncFree(context);
+        }
+        m_connected = false;
+    }
+    m_running = false;
+    if (m_wakeupfd >= 0) {
+        uint64_t one = 1;
+        [[maybe_unused]] auto n = write(m_wakeupfd, &one, sizeof(one));
+    }
+    if (m_thread.joinable()) {
+        if (m_thread.get_id() == std::this_thread::get_id()) {
+            m_thread.detach();
+        } else {
+            m_thread.join();
+        }
+    }
+    if (m_wakeupfd >= 0) {
+        close(m_wakeupfd);
+        m_wakeupfd = -1;
+    }
+    if (m_epollfd >= 0) {
+        close(m_epollfd);
+        m_epollfd = -1;
+    }
+    m_socketfd = -1;
+}
+void RedisAsyncClient::Command(const std::vector<std::string_view>& argv, Callback callback) {
+    Command(argv.data(), argv.size(), std::move(callback));
+}
+void RedisAsyncClient::Command(const std::string_view* argv, size_t argc, Callback callback) {
+    std::lock_guard guard(m_mutex);
+    if (!m_context) {
+        throw std::runtime_error("redis async client without connection");
+    }
+    m_argv.resize(argc);
+    m_argvlen.resize(argc);
+    for (size_t i = 0; i < argc; ++i) {
+        m_argv[i] = argv[i].data();
+        m_argvlen[i] = argv[i].size();
+    }
+    auto privdata = new Callback(std::move(callback));
+    if (redisAsyncCommandArgv(m_context, &RedisAsyncClient::OnReply, privdata
+        , (int)argc, m_argv.data(), m_argvlen.data()) != REDIS_OK) {
+        delete privdata;
+        throw std::runtime_error(std::string("redis async command error, command : ") + std::string(argv[0]));
+    }
+}
+void RedisAsyncClient::OnReply(redisAsyncContext* context, void* reply, void* privdata) {
+    auto callback = static_cast<Callback*>(privdata);
+    try {
+        (*callback)(static_cast<redisReply*>(reply));
+    } catch (const std::exception& e) {
+        auto self = static_cast<RedisAsyncClient*>(context->data);
+        ++self->m_callbackErrors;
+        RedisReportError(self->m_errorHandler, "callback", e);
+    }
+    delete callback;
+}
+void RedisAsyncClient::OnConnect(const redisAsyncContext* context, int status) {
+    auto self = static_cast<RedisAsyncClient*>(context->data);
+    self->m_connectStatus = status;
+    if (status == REDIS_OK) {
+        self->m_connected = true;
+    } else {
+        /** hiredis frees the context once this callback returns */
+        self->m_context = nullptr;
+    }
+    self->m_connectCond.notify_all();
+}
+void RedisAsyncClient::OnDisconnect(const redisAsyncContext* context, int) {
+    auto self = static_cast<RedisAsyncClient*>(context->data);
+    self->m_connected = false;
+    self->m_context = nullptr;
+    self->m_connectCond.notify_all();
+}
+void RedisAsyncClient::AddRead(void* privdata) {
+    static_cast<RedisAsyncClient*>(privdata)->UpdateEvents(EPOLLIN, true);
+}
+void RedisAsyncClient::DelRead(void* privdata) {
+    static_cast<RedisAsyncClient*>(privdata)->UpdateEvents(EPOLLIN, false);
+}
+void RedisAsyncClient::AddWrite(void* privdata) {
+    static_cast<RedisAsyncClient*>(privdata)->UpdateEvents(EPOLLOUT, true);
+}
+void RedisAsyncClient::DelWrite(void* privdata) {
+    static_cast<RedisAsyncClient*>(privdata)->UpdateEvents(EPOLLOUT, false);
+}
+void RedisAsyncClient::Cleanup(void* privdata) {
+    auto self = static_cast<RedisAsyncClient*>(privdata);
+    if (self->m_epollfd >= 0 && self->m_socketfd >= 0) {
+        epoll_ctl(self->m_epollfd, EPOLL_CTL_DEL, self->m_socketfd, nullptr);
+    }
+    self->m_events = 0;
+}
+void RedisAsyncClient::UpdateEvents(uint32_t events, bool enable) {
+    auto update = enable ? (m_events | events) : (m_events & ~events);
+    if (update == m_events) {
+        return;
+    }
+    m_events = update;
+    epoll_event event {};
+    event.events = m_events;
+    event.data.fd = m_socketfd;
+    epoll_ctl(m_epollfd, EPOLL_CTL_MOD, m_socketfd, &event);
+}
+void RedisAsyncClient::Loop() {
+    epoll_event events[8];
+    while (m_running) {
+        auto count = epoll_wait(m_epollfd, events, 8, 100);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == m_wakeupfd) {
+                uint64_t value;
+                [[maybe_unused]] auto n = read(m_wakeupfd, &value, sizeof(value));
+                continue;
+            }
+            std::lock_guard guard(m_mutex);
+            if (m_context && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+                redisAsyncHandleRead(m_context);
+            }
+            if (m_context && (events[i].events & (EPOLLOUT | EPOLLERR))) {
+                redisAsyncHandleWrite(m_context);
+            }
+        }
+    }
+}
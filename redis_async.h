@@ -0,0 +1,178 @@
+/**
+ * @file redis_async.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-03
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_ASYNC_H____
+#define ____REDIS_ASYNC_H____
+
+#include <atomic>
+#include <condition_variable>
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#   include <coroutine>
+#   define REDIS_COROUTINE_SUPPORT 1
+#endif
+
+#include "redis.h"
+#include "async.h"
+
+/**
+ * @brief non-blocking client on redisAsyncContext, driven by its own epoll loop thread
+ *        every command is written without waiting and the reply is delivered to a future or callback,
+ *        so one connection keeps many requests in flight.
+ *        blocking commands (BLPOP ...) still block the connection on the server side,
+ *        give them a dedicated RedisAsyncClient.
+ */
+class RedisAsyncClient final : public RedisCommands<RedisAsyncClient> {
+    friend class RedisCommands<RedisAsyncClient>;
+public:
+    using Ptr = std::shared_ptr<RedisAsyncClient>;
+    using Callback = std::function<void(redisReply*)>;
+    static RedisAsyncClient::Ptr Create(const std::string& ip = "127.0.0.1"
+        , const uint16_t port = 6379, const std::string& password = "");
+
+    RedisAsyncClient();
+    RedisAsyncClient(const std::string& ip, const uint16_t port, const std::string& password = "");
+    ~RedisAsyncClient();
+
+    /** false when the server is not reached in time, throws when it rejects the password */
+    bool Connect();
+    bool ConnectWithTimeout(uint64_t ms);
+    bool ConnectWithTimeout(const std::string& ip, const uint16_t port, uint64_t ms, const std::string& password = "");
+    void Close();
+    bool IsConnected() const { return m_connected; }
+    /** receives the exceptions thrown by reply callbacks, set it before the first command */
+    void SetErrorHandler(RedisErrorHandler handler) { m_errorHandler = std::move(handler); }
+    /** reply callbacks that threw */
+    uint64_t GetCallbackErrors() const { return m_callbackErrors; }
+
+    /** callback runs on the loop thread, reply is freed when it returns (nullptr if the connection is lost) */
+    void Command(const std::vector<std::string_view>& argv, Callback callback);
+    void Command(const std::string_view* argv, size_t argc, Callback callback);
+protected:
+    template <typename T>
+    std::future<T> Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        auto promise = std::make_shared<std::promise<T>>();
+        auto future = promise->get_future();
+        const char* command = argv[0].data();
+        Command(argv, argc, [promise, convert, command](redisReply* reply) {
+            try {
+                promise->set_value(convert(reply, command));
+            } catch (...) {
+                promise->set_exception(std::current_exception());
+            }
+        });
+        return future;
+    }
+private:
+    static void OnReply(redisAsyncContext* context, void* reply, void* privdata);
+    static void OnConnect(const redisAsyncContext* context, int status);
+    static void OnDisconnect(const redisAsyncContext* context, int status);
+    static void AddRead(void* privdata);
+    static void DelRead(void* privdata);
+    static void AddWrite(void* privdata);
+    static void DelWrite(void* privdata);
+    static void Cleanup(void* privdata);
+    void UpdateEvents(uint32_t events, bool enable);
+    void Loop();
+private:
+    enum AuthStatus : int32_t { authPending, authOk, authFailed };
+    std::string m_host;
+    uint16_t m_port;
+    std::string m_password;
+    std::recursive_mutex m_mutex;
+    std::condition_variable_any m_connectCond;
+    redisAsyncContext* m_context;
+    int m_connectStatus;
+    /** reply of AUTH, guarded by m_mutex */
+    AuthStatus m_authStatus;
+    std::atomic<bool> m_connected;
+    std::atomic<bool> m_running;
+    int m_epollfd;
+    int m_wakeupfd;
+    int m_socketfd;
+    uint32_t m_events;
+    std::thread m_thread;
+    std::vector<const char*> m_argv;
+    std::vector<size_t> m_argvlen;
+    RedisErrorHandler m_errorHandler;
+    std::atomic<uint64_t> m_callbackErrors;
+};
+
+#ifdef REDIS_COROUTINE_SUPPORT
+/**
+ * @brief awaitable reply of one command, the command is written when the awaitable is created
+ *        the awaiting coroutine is resumed on the loop thread of the RedisAsyncClient
+ */
+template <typename T>
+class RedisAwaitable {
+public:
+    RedisAwaitable(RedisAsyncClient& client, RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc)
+        : m_state (std::make_shared<State>()) {
+        const char* command = argv[0].data();
+        client.Command(argv, argc, [state = m_state, convert, command](redisReply* reply) {
+            try {
+                state->value.emplace(convert(reply, command));
+            } catch (...) {
+                state->error = std::current_exception();
+            }
+            if (state->status.exchange(done) == suspended) {
+                state->handle.resume();
+            }
+        });
+    }
+    bool await_ready() const noexcept {
+        return m_state->status.load() == done;
+    }
+    bool await_suspend(std::coroutine_handle<> handle) noexcept {
+        m_state->handle = handle;
+        int32_t expected = pending;
+        /** the reply may already have arrived, then continue without suspending */
+        return m_state->status.compare_exchange_strong(expected, suspended);
+    }
+    T await_resume() {
+        if (m_state->error) {
+            std::rethrow_exception(m_state->error);
+        }
+        return std::move(*m_state->value);
+    }
+private:
+    enum Status : int32_t { pending, suspended, done };
+    struct State {
+        std::atomic<int32_t> status {pending};
+        std::coroutine_handle<> handle;
+        std::optional<T> value;
+        std::exception_ptr error;
+    };
+    std::shared_ptr<State> m_state;
+};
+
+/**
+ * @brief co_await-able view of a RedisAsyncClient, e.g. auto value = co_await client.get(key);
+ *        replies are decoded by the same RedisReplyConverter as the other front ends and RedisClient,
+ *        a command answers a lost connection here as it does there
+ */
+class RedisCoroutineClient final : public RedisCommands<RedisCoroutineClient> {
+    friend class RedisCommands<RedisCoroutineClient>;
+public:
+    explicit RedisCoroutineClient(RedisAsyncClient::Ptr client)
+        : m_client (client) {
+    }
+    RedisAsyncClient::Ptr GetClient() const { return m_client; }
+protected:
+    template <typename T>
+    RedisAwaitable<T> Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        return RedisAwaitable<T>(*m_client, convert, argv, argc);
+    }
+private:
+    RedisAsyncClient::Ptr m_client;
+};
+#endif // REDIS_COROUTINE_SUPPORT
+
+#endif // ! ____REDIS_ASYNC_H____
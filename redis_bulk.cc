@@ -0,0 +1,201 @@
+#include "redis_bulk.h"
+#include <cerrno>
+#include <cstring>
+
+#include <poll.h>
+#include <sys/socket.h>
+
+RedisBulkLoader::RedisBulkLoader(RedisClient::Ptr client, const RedisBulkLoaderOptions& options, Progress progress)
+    : m_client (client), m_options (options), m_progress (std::move(progress)) {
+    if (!m_client || m_client->IsBroken()) {
+        throw std::runtime_error("redis bulk loader without connection");
+    }
+    m_options.window = std::max<size_t>(m_options.window, 1);
+    m_fd = m_client->m_context->fd;
+    m_buffer.reserve(m_options.batch_bytes + 4096);
+    m_start = std::chrono::steady_clock::now();
+    m_reader = std::thread(&RedisBulkLoader::Read, this);
+}
+RedisBulkLoader::~RedisBulkLoader() {
+    try {
+        Finish();
+    } catch (const std::exception& e) {
+        RedisReportError(m_options.error_handler, "finish", e);
+    }
+}
+void RedisBulkLoader::set(std::string_view key, std::string_view value) {
+    RedisAppendCommand(m_buffer, {"SET", key, value});
+    Appended();
+}
+void RedisBulkLoader::hset(std::string_view key, std::string_view field, std::string_view value) {
+    RedisAppendCommand(m_buffer, {"HSET", key, field, value});
+    Appended();
+}
+void RedisBulkLoader::Command(std::initializer_list<std::string_view> argv) {
+    RedisAppendCommand(m_buffer, argv);
+    Appended();
+}
+void RedisBulkLoader::Appended() {
+    if (m_finished) {
+        throw std::runtime_error("redis bulk loader used after Finish");
+    }
+    auto records = m_records.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (m_buffer.size() >= m_options.batch_bytes) {
+        Flush();
+    }
+    if (m_progress && m_options.progress_records && records % m_options.progress_records == 0) {
+        m_progress(Stats());
+    }
+}
+void RedisBulkLoader::Flush() {
+    if (m_buffer.empty()) {
+        return;
+    }
+    {
+        std::unique_lock lock(m_mutex);
+        m_cond.wait(lock, [this]() {
+            while (!m_batches.empty() && m_replies >= m_batches.front()) {
+                m_batches.pop_front();
+            }
+            return m_batches.size() < m_options.window || !m_failure.empty();
+        });
+        if (!m_failure.empty()) {
+            throw std::runtime_error("redis bulk loader error, error message : " + m_failure);
+        }
+        /** counted before the write, a fast reply must find its batch */
+        m_sentRecords = m_records.load(std::memory_order_relaxed);
+        m_batches.push_back(m_sentRecords);
+    }
+    WriteAll(m_buffer.data(), m_buffer.size());
+    m_bytes.fetch_add(m_buffer.size(), std::memory_order_relaxed);
+    m_buffer.clear();
+}
+void RedisBulkLoader::WriteAll(const char* data, size_t size) {
+    while (size > 0) {
+        auto written = ::send(m_fd, data, size, MSG_NOSIGNAL);
+        if (written > 0) {
+            data += written;
+            size -= written;
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            pollfd pfd {m_fd, POLLOUT, 0};
+            ::poll(&pfd, 1, 100);
+            continue;
+        }
+        auto error = std::string(strerror(errno));
+        {
+            std::lock_guard guard(m_mutex);
+            m_failure = error;
+        }
+        throw std::runtime_error("redis bulk loader write error, error message : " + error);
+    }
+}
+void RedisBulkLoader::Read() {
+    std::unique_ptr<redisReader, void (*)(redisReader*)> reader(redisReaderCreate(), redisReaderFree);
+    std::vector<char> buffer(64 * 1024);
+    auto fail = [this](std::string error) {
+        std::lock_guard guard(m_mutex);
+        m_failure = std::move(error);
+        m_cond.notify_all();
+    };
+    while (true) {
+        {
+            std::lock_guard guard(m_mutex);
+            if (m_stop && m_replies >= m_sentRecords) {
+                return;
+            }
+        }
+        pollfd pfd {m_fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        auto received = ::recv(m_fd, buffer.data(), buffer.size(), 0);
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+            continue;
+        }
+        if (received <= 0) {
+            fail(received == 0 ? "connection closed" : strerror(errno));
+            return;
+        }
+        if (redisReaderFeed(reader.get(), buffer.data(), received) != REDIS_OK) {
+            fail(reader->errstr);
+            return;
+        }
+        uint64_t replies = 0;
+        uint64_t errors = 0;
+        std::string firstError;
+        void* reply = nullptr;
+        while (true) {
+            if (redisReaderGetReply(reader.get(), &reply) != REDIS_OK) {
+                fail(reader->errstr);
+                return;
+            }
+            if (!reply) {
+                break;
+            }
+            auto r = static_cast<redisReply*>(reply);
+            if (r->type == REDIS_REPLY_ERROR && ++errors == 1) {
+                firstError.assign(r->str, r->len);
+            }
+            freeReplyObject(reply);
+            ++replies;
+        }
+        if (replies) {
+            std::lock_guard guard(m_mutex);
+            m_replies += replies;
+            m_errors += errors;
+            if (m_firstError.empty()) {
+                m_firstError = std::move(firstError);
+            }
+            m_cond.notify_all();
+        }
+    }
+}
+RedisBulkLoaderStats RedisBulkLoader::Finish() {
+    if (m_finished) {
+        return Stats();
+    }
+    std::exception_ptr error;
+    try {
+        Flush();
+        std::unique_lock lock(m_mutex);
+        m_cond.wait(lock, [this]() { return m_replies >= m_sentRecords || !m_failure.empty(); });
+    } catch (...) {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard guard(m_mutex);
+        m_stop = true;
+        m_end = std::chrono::steady_clock::now();
+        if (!m_failure.empty()) {
+            /** replies still missing can never arrive, the reader must not wait for them */
+            m_sentRecords = m_replies;
+        }
+    }
+    m_finished = true;
+    if (m_reader.joinable()) {
+        m_reader.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    auto stats = Stats();
+    std::lock_guard guard(m_mutex);
+    if (!m_failure.empty()) {
+        throw std::runtime_error("redis bulk loader error, error message : " + m_failure);
+    }
+    return stats;
+}
+RedisBulkLoaderStats RedisBulkLoader::Stats() const {
+    RedisBulkLoaderStats stats;
+    std::lock_guard guard(m_mutex);
+    stats.records = m_records.load(std::memory_order_relaxed);
+    stats.replies = m_replies;
+    stats.errors = m_errors;
+    stats.first_error = m_firstError;
+    stats.bytes = m_bytes.load(std::memory_order_relaxed);
+    auto end = m_stop ? m_end : std::chrono::steady_clock::now();
+    stats.seconds = std::chrono::duration<double>(end - m_start).count();
+    return stats;
+}
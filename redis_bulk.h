@@ -0,0 +1,110 @@
+/**
+ * @file redis_bulk.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-10
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_BULK_H____
+#define ____REDIS_BULK_H____
+
+#include <tuple>
+
+#include "redis.h"
+
+struct RedisBulkLoaderOptions {
+    /** commands are encoded into a buffer of about this size before it is written */
+    size_t batch_bytes = 1024 * 1024;
+    /** written batches whose replies have not all arrived yet, the writer waits beyond this */
+    size_t window = 8;
+    /** called from the loading thread after every this many records, 0 never calls */
+    size_t progress_records = 0;
+    /** optional, receives the failure of a loader destroyed without Finish, which has nowhere else to go */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisBulkLoaderStats {
+    uint64_t records = 0;
+    uint64_t replies = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    /** the first error reply, the others are only counted */
+    std::string first_error;
+    double RecordsPerSecond() const { return seconds > 0 ? replies / seconds : 0; }
+};
+
+/**
+ * @brief streams commands into one connection the way redis-cli --pipe does.
+ *        records are encoded as RESP straight into a large buffer which is written as a whole,
+ *        a reader thread parses and counts the replies meanwhile, so writing never waits for a round trip.
+ *        error replies are counted, they do not stop the load. the connection must not be used otherwise
+ *        until Finish returns.
+ *        e.g. RedisBulkLoader loader(client); loader.Load(records.begin(), records.end()); auto stats = loader.Finish();
+ */
+class RedisBulkLoader final {
+public:
+    using Progress = std::function<void(const RedisBulkLoaderStats&)>;
+    explicit RedisBulkLoader(RedisClient::Ptr client
+        , const RedisBulkLoaderOptions& options = RedisBulkLoaderOptions(), Progress progress = nullptr);
+    RedisBulkLoader(const RedisBulkLoader&) = delete;
+    RedisBulkLoader& operator=(const RedisBulkLoader&) = delete;
+    ~RedisBulkLoader();
+
+    /** SET             */ void set(std::string_view key, std::string_view value);
+    /** HSET            */ void hset(std::string_view key, std::string_view field, std::string_view value);
+    /** any command, one record */
+    void Command(std::initializer_list<std::string_view> argv);
+
+    /** records are pairs (SET key value) or tuples of three (HSET key field value) */
+    template <typename Iterator>
+    void Load(Iterator begin, Iterator end) {
+        for (; begin != end; ++begin) {
+            if constexpr (std::tuple_size_v<std::decay_t<decltype(*begin)>> == 2) {
+                set(std::get<0>(*begin), std::get<1>(*begin));
+            } else {
+                hset(std::get<0>(*begin), std::get<1>(*begin), std::get<2>(*begin));
+            }
+        }
+    }
+
+    /** writes what is buffered and waits for every reply, the loader can not be used afterwards */
+    RedisBulkLoaderStats Finish();
+    /** counters so far, callable from any thread */
+    RedisBulkLoaderStats Stats() const;
+private:
+    void Appended();
+    /** writes the buffer, first waiting until fewer than window batches are unanswered */
+    void Flush();
+    void WriteAll(const char* data, size_t size);
+    void Read();
+private:
+    RedisClient::Ptr m_client;
+    RedisBulkLoaderOptions m_options;
+    Progress m_progress;
+    int m_fd = -1;
+    std::string m_buffer;
+    std::atomic<uint64_t> m_records {0};
+    std::atomic<uint64_t> m_bytes {0};
+    std::chrono::steady_clock::time_point m_start;
+    bool m_finished = false;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cond;
+    /** records sent up to the end of each unanswered batch */
+    std::deque<uint64_t> m_batches;
+    uint64_t m_sentRecords = 0;
+    uint64_t m_replies = 0;
+    uint64_t m_errors = 0;
+    std::string m_firstError;
+    /** set by the reader when the connection is gone */
+    std::string m_failure;
+    bool m_stop = false;
+    std::chrono::steady_clock::time_point m_end;
+    std::thread m_reader;
+};
+
+#endif // ! ____REDIS_BULK_H____
@@ -0,0 +1,423 @@
+#include "redis_cache.h"
+
+#include <sys/socket.h>
+
+namespace {
+/** epochs are unique across caches, a connection tracked for one cache is never taken as tracked by another */
+std::atomic<uint64_t> s_epochs {0};
+
+/** the low bits of a key's hash also picked its shard and are the same for every key of it, mixed before they index the sketch */
+uint64_t Spread(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+}
+
+void RedisNearCache::FrequencySketch::Resize(size_t width) {
+    size_t size = 1;
+    while (size < width) {
+        size <<= 1;
+    }
+    counters.assign(size * 4, 0);
+    mask = size - 1;
+    additions = 0;
+    samplePeriod = size * 10;
+}
+void RedisNearCache::FrequencySketch::Increment(size_t hash) {
+    hash = Spread(hash);
+    for (size_t row = 0; row < 4; ++row) {
+        auto& counter = counters[row * (mask + 1) + ((hash >> (row * 8)) * (2 * row + 1) & mask)];
+        if (counter < 15) {
+            ++counter;
+        }
+    }
+    if (++additions >= samplePeriod) {
+        for (auto& counter : counters) {
+            counter >>= 1;
+        }
+        additions /= 2;
+    }
+}
+uint32_t RedisNearCache::FrequencySketch::Estimate(size_t hash) const {
+    hash = Spread(hash);
+    uint32_t estimate = 15;
+    for (size_t row = 0; row < 4; ++row) {
+        estimate = std::min<uint32_t>(estimate, counters[row * (mask + 1) + ((hash >> (row * 8)) * (2 * row + 1) & mask)]);
+    }
+    return estimate;
+}
+
+RedisNearCache::RedisNearCache(const RedisNearCacheOptions& options)
+    : m_options (options) {
+    m_options.shards = m_options.shards ? m_options.shards : 1;
+    m_shards.reset(new Shard[m_options.shards]);
+    for (size_t i = 0; i < m_options.shards; ++i) {
+        m_shards[i].budget = m_options.max_bytes / m_options.shards;
+        /** about one counter per 64 cached bytes */
+        m_shards[i].sketch.Resize(std::max<size_t>(m_shards[i].budget / 64, 64));
+    }
+}
+RedisNearCache::~RedisNearCache() {
+    Stop();
+}
+bool RedisNearCache::Start(const std::string& ip, const uint16_t port, const std::string& password) {
+    Stop();
+    m_host = ip, m_port = port, m_password = password;
+    int64_t id = 0;
+    auto listener = OpenListener(id);
+    m_running = true;
+    m_thread = std::thread(&RedisNearCache::Listen, this, listener, id);
+    return listener != nullptr;
+}
+void RedisNearCache::Stop() {
+    {
+        std::lock_guard guard(m_stateMutex);
+        m_running = false;
+        /** wakes the listener out of its blocking read */
+        if (m_listener && m_listener->m_context) {
+            ::shutdown(m_listener->m_context->fd, SHUT_RDWR);
+        }
+    }
+    m_stopCond.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    Untrack();
+}
+void RedisNearCache::Clear() {
+    for (size_t i = 0; i < m_options.shards; ++i) {
+        auto& shard = m_shards[i];
+        std::lock_guard guard(shard.mutex);
+        shard.index.clear();
+        shard.lru.clear();
+        shard.bytes = 0;
+    }
+}
+RedisNearCacheStats RedisNearCache::Stats() const {
+    RedisNearCacheStats stats;
+    for (size_t i = 0; i < m_options.shards; ++i) {
+        auto& shard = m_shards[i];
+        std::lock_guard guard(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.invalidations += shard.invalidations;
+        stats.evictions += shard.evictions;
+        stats.rejections += shard.rejections;
+        stats.entries += shard.index.size();
+        stats.bytes += shard.bytes;
+    }
+    stats.listener_failures = m_listenerFailures.load(std::memory_order_relaxed);
+    return stats;
+}
+std::optional<std::string> RedisNearCache::get(RedisClient& client, const std::string& key) {
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    {
+        std::lock_guard guard(shard.mutex);
+        shard.sketch.Increment(hash);
+        if (auto it = shard.index.find(key); it != shard.index.end() && it->second->value) {
+            ++shard.hits;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return *it->second->value;
+        }
+        ++shard.misses;
+    }
+    auto token = Reserve(key, EnsureTracking(client));
+    auto value = client.get(key);
+    if (token) {
+        Fill(key, token, [&value](Node& node) { node.value = value; });
+    }
+    return value;
+}
+std::optional<std::string> RedisNearCache::hget(RedisClient& client, const std::string& key, const std::string& field) {
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    {
+        std::lock_guard guard(shard.mutex);
+        shard.sketch.Increment(hash);
+        if (auto it = shard.index.find(key); it != shard.index.end()) {
+            auto& node = *it->second;
+            if (node.all) {
+                ++shard.hits;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                auto value = node.all->find(field);
+                return value == node.all->end() ? std::nullopt : std::optional<std::string>(value->second);
+            }
+            if (auto value = node.fields.find(field); value != node.fields.end()) {
+                ++shard.hits;
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+                return value->second;
+            }
+        }
+        ++shard.misses;
+    }
+    auto token = Reserve(key, EnsureTracking(client));
+    auto value = client.hget(key, field);
+    if (token) {
+        Fill(key, token, [&field, &value](Node& node) { node.fields[field] = value; });
+    }
+    return value;
+}
+std::unordered_map<std::string, std::string> RedisNearCache::hgetall(RedisClient& client, const std::string& key) {
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    {
+        std::lock_guard guard(shard.mutex);
+        shard.sketch.Increment(hash);
+        if (auto it = shard.index.find(key); it != shard.index.end() && it->second->all) {
+            ++shard.hits;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return *it->second->all;
+        }
+        ++shard.misses;
+    }
+    auto token = Reserve(key, EnsureTracking(client));
+    auto values = client.hgetall(key);
+    if (token) {
+        Fill(key, token, [&values](Node& node) {
+            node.all = values;
+            node.fields.clear();
+        });
+    }
+    return values;
+}
+std::vector<std::optional<std::string>> RedisNearCache::mget(RedisClient& client, const std::vector<std::string>& keys) {
+    std::vector<std::optional<std::string>> values(keys.size());
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        size_t hash;
+        auto& shard = ShardOf(keys[i], hash);
+        std::lock_guard guard(shard.mutex);
+        shard.sketch.Increment(hash);
+        if (auto it = shard.index.find(keys[i]); it != shard.index.end() && it->second->value) {
+            ++shard.hits;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            values[i] = *it->second->value;
+        } else {
+            ++shard.misses;
+            missing.push_back(i);
+        }
+    }
+    if (missing.empty()) {
+        return values;
+    }
+    auto epoch = EnsureTracking(client);
+    std::vector<std::string> missingKeys;
+    std::vector<uint64_t> tokens;
+    for (auto i : missing) {
+        missingKeys.push_back(keys[i]);
+        tokens.push_back(Reserve(keys[i], epoch));
+    }
+    auto fetched = client.mget(missingKeys);
+    for (size_t j = 0; j < missing.size() && j < fetched.size(); ++j) {
+        values[missing[j]] = fetched[j];
+        if (tokens[j]) {
+            Fill(missingKeys[j], tokens[j], [&value = fetched[j]](Node& node) { node.value = value; });
+        }
+    }
+    return values;
+}
+RedisNearCache::Shard& RedisNearCache::ShardOf(std::string_view key, size_t& hash) const {
+    hash = std::hash<std::string_view>()(key);
+    return m_shards[hash % m_options.shards];
+}
+uint64_t RedisNearCache::EnsureTracking(RedisClient& client) {
+    auto epoch = m_epoch.load();
+    if (!epoch || client.m_trackingEpoch == epoch) {
+        return epoch;
+    }
+    int64_t listenerId;
+    {
+        std::lock_guard guard(m_stateMutex);
+        epoch = m_epoch.load();
+        if (!epoch) {
+            return 0;
+        }
+        listenerId = m_listenerId;
+    }
+    /** the round trip runs unlocked, readers on other connections and the listener are not held up by it */
+    auto id = std::to_string(listenerId);
+    auto reply = client.CommandArgv({"CLIENT", "TRACKING", "ON", "REDIRECT", id});
+    if (!reply || reply->type != REDIS_REPLY_STATUS) {
+        /** the read still goes to the server, it is just not cached */
+        return 0;
+    }
+    std::lock_guard guard(m_stateMutex);
+    /** the listener was replaced meanwhile, the next read redirects to the new one */
+    if (m_epoch.load() != epoch) {
+        return 0;
+    }
+    client.m_trackingEpoch = epoch;
+    return epoch;
+}
+uint64_t RedisNearCache::Reserve(const std::string& key, uint64_t epoch) {
+    if (!epoch) {
+        return 0;
+    }
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    std::lock_guard guard(shard.mutex);
+    /** checked under the shard lock, Untrack bumps the epoch before it clears the shards */
+    if (m_epoch.load() != epoch) {
+        return 0;
+    }
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        return it->second->token;
+    }
+    shard.lru.emplace_front();
+    auto& node = shard.lru.front();
+    node.key = key;
+    node.token = ++m_tokens;
+    node.bytes = NodeBytes(node);
+    shard.bytes += node.bytes;
+    shard.index.emplace(node.key, shard.lru.begin());
+    return node.token;
+}
+void RedisNearCache::Fill(const std::string& key, uint64_t token, const std::function<void(Node&)>& update) {
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    std::lock_guard guard(shard.mutex);
+    auto found = shard.index.find(key);
+    /** invalidated while the read was in flight, the value may already be stale */
+    if (found == shard.index.end() || found->second->token != token) {
+        return;
+    }
+    auto it = found->second;
+    update(*it);
+    shard.bytes -= it->bytes;
+    it->bytes = NodeBytes(*it);
+    shard.bytes += it->bytes;
+    shard.lru.splice(shard.lru.begin(), shard.lru, it);
+
+    auto frequency = shard.sketch.Estimate(hash);
+    while (shard.bytes > shard.budget && shard.lru.size() > 1) {
+        auto victim = std::prev(shard.lru.end());
+        if (frequency <= shard.sketch.Estimate(std::hash<std::string_view>()(victim->key))) {
+            Evict(shard, it);
+            ++shard.rejections;
+            return;
+        }
+        Evict(shard, victim);
+        ++shard.evictions;
+    }
+    if (shard.bytes > shard.budget) {
+        Evict(shard, it);
+        ++shard.rejections;
+    }
+}
+void RedisNearCache::Invalidate(std::string_view key) {
+    size_t hash;
+    auto& shard = ShardOf(key, hash);
+    std::lock_guard guard(shard.mutex);
+    if (auto it = shard.index.find(key); it != shard.index.end()) {
+        Evict(shard, it->second);
+        ++shard.invalidations;
+    }
+}
+void RedisNearCache::Evict(Shard& shard, std::list<Node>::iterator it) {
+    shard.index.erase(it->key);
+    shard.bytes -= it->bytes;
+    shard.lru.erase(it);
+}
+size_t RedisNearCache::NodeBytes(const Node& node) {
+    /** rough per allocation overhead included so many tiny entries still count */
+    size_t bytes = sizeof(Node) + node.key.size() + 64;
+    if (node.value && *node.value) {
+        bytes += (*node.value)->size();
+    }
+    for (auto& [field, value] : node.fields) {
+        bytes += field.size() + (value ? value->size() : 0) + 64;
+    }
+    if (node.all) {
+        for (auto& [field, value] : *node.all) {
+            bytes += field.size() + value.size() + 64;
+        }
+    }
+    return bytes;
+}
+RedisClient::Ptr RedisNearCache::OpenListener(int64_t& id) {
+    auto listener = std::make_shared<RedisClient>();
+    try {
+        if (!listener->ConnectWithTimeout(m_host, m_port, m_options.connect_timeout_ms, m_password)) {
+            throw std::runtime_error("redis near cache listener connect error:( " + m_host + " : " + std::to_string(m_port));
+        }
+        auto reply = listener->CommandArgv({"CLIENT", "ID"});
+        if (!reply || reply->type != REDIS_REPLY_INTEGER) {
+            throw std::runtime_error("redis near cache listener error, command : CLIENT ID");
+        }
+        id = reply->integer;
+        reply = listener->CommandArgv({"SUBSCRIBE", "__redis__:invalidate"});
+        if (!reply || reply->type != REDIS_REPLY_ARRAY) {
+            throw std::runtime_error("redis near cache listener error, command : SUBSCRIBE __redis__:invalidate");
+        }
+    } catch (const std::exception& e) {
+        m_listenerFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "listener", e);
+        return nullptr;
+    }
+    return listener;
+}
+bool RedisNearCache::Track(RedisClient::Ptr listener, int64_t id) {
+    std::lock_guard guard(m_stateMutex);
+    /** checked under the lock Stop takes, so Stop either sees this listener or we see Stop */
+    if (!m_running) {
+        return false;
+    }
+    m_listener = listener;
+    m_listenerId = id;
+    /** entries from before were not reported to this listener */
+    Clear();
+    m_epoch = ++s_epochs;
+    return true;
+}
+void RedisNearCache::Untrack() {
+    {
+        std::lock_guard guard(m_stateMutex);
+        m_epoch = 0;
+        m_listener.reset();
+    }
+    /** invalidations may have been missed, nothing cached can be trusted any more */
+    Clear();
+}
+void RedisNearCache::Listen(RedisClient::Ptr listener, int64_t id) {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    while (m_running) {
+        if (!listener) {
+            std::unique_lock lock(m_stateMutex);
+            m_stopCond.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return !m_running; });
+            lock.unlock();
+            backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+            listener = m_running ? OpenListener(id) : nullptr;
+            continue;
+        }
+        if (!Track(listener, id)) {
+            break;
+        }
+        backoff = m_options.reconnect_backoff_min_ms;
+
+        auto context = listener->m_context.get();
+        redisReply* r = nullptr;
+        while (redisGetReply(context, (void**)&r) == REDIS_OK) {
+            auto reply = listener->WrapReply(r);
+            if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements != 3
+                || reply->element[0]->type != REDIS_REPLY_STRING || strcmp(reply->element[0]->str, "message")) {
+                continue;
+            }
+            auto keys = reply->element[2];
+            if (keys->type == REDIS_REPLY_ARRAY) {
+                for (size_t i = 0; i < keys->elements; ++i) {
+                    Invalidate(std::string_view(keys->element[i]->str, keys->element[i]->len));
+                }
+            } else {
+                /** FLUSHALL / FLUSHDB send a nil key list */
+                Clear();
+            }
+        }
+        Untrack();
+        listener.reset();
+    }
+}
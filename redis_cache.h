@@ -0,0 +1,137 @@
+/**
+ * @file redis_cache.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-06
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_CACHE_H____
+#define ____REDIS_CACHE_H____
+
+#include <list>
+
+#include "redis.h"
+
+struct RedisNearCacheOptions {
+    /** upper bound of the cached keys and values, split evenly between the shards */
+    size_t max_bytes = 64 * 1024 * 1024;
+    size_t shards = 16;
+    int64_t connect_timeout_ms = 50;
+    /** the invalidation connection is reconnected with this backoff, the cache is bypassed meanwhile */
+    int64_t reconnect_backoff_min_ms = 10;
+    int64_t reconnect_backoff_max_ms = 1000;
+    /** optional, receives what the stats count as listener_failures, on the listener thread */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisNearCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+    uint64_t evictions = 0;
+    /** candidates the frequency filter kept out because the entry they would evict is hotter */
+    uint64_t rejections = 0;
+    uint64_t entries = 0;
+    uint64_t bytes = 0;
+    /** listener connects that failed, the cache is bypassed until one succeeds */
+    uint64_t listener_failures = 0;
+};
+
+/**
+ * @brief near cache for GET, HGET, HGETALL and MGET kept coherent by server assisted client side caching.
+ *        a listener connection subscribes to __redis__:invalidate, every connection that reads through
+ *        the cache is switched to CLIENT TRACKING ON REDIRECT <listener id>, so the server reports each
+ *        change of a key that was read. without a listener (not started, reconnecting) reads go to the server.
+ *        eviction is LRU with a TinyLFU admission filter, a new key only displaces a key read less often.
+ *        e.g. auto conn = guard.Get(); auto value = cache->get(*conn, "config:feature");
+ */
+class RedisNearCache final {
+public:
+    using Ptr = std::shared_ptr<RedisNearCache>;
+    explicit RedisNearCache(const RedisNearCacheOptions& options = RedisNearCacheOptions());
+    RedisNearCache(const RedisNearCache&) = delete;
+    RedisNearCache& operator=(const RedisNearCache&) = delete;
+    ~RedisNearCache();
+
+    /** starts the invalidation listener, false when its first connect fails (it keeps retrying) */
+    bool Start(const std::string& ip, const uint16_t port, const std::string& password = "");
+    void Stop();
+    bool IsTracking() const { return m_epoch.load() != 0; }
+    /** drops every entry */
+    void Clear();
+    RedisNearCacheStats Stats() const;
+
+    std::optional<std::string> get(RedisClient& client, const std::string& key);
+    std::optional<std::string> hget(RedisClient& client, const std::string& key, const std::string& field);
+    std::unordered_map<std::string, std::string> hgetall(RedisClient& client, const std::string& key);
+    std::vector<std::optional<std::string>> mget(RedisClient& client, const std::vector<std::string>& keys);
+private:
+    /** every cached reply derived from one redis key, dropped as a whole when the key is invalidated */
+    struct Node {
+        std::string key;
+        /** fills are only accepted from reads that started while this node existed */
+        uint64_t token = 0;
+        std::optional<std::optional<std::string>> value;
+        std::unordered_map<std::string, std::optional<std::string>> fields;
+        std::optional<std::unordered_map<std::string, std::string>> all;
+        size_t bytes = 0;
+    };
+    /** 4 bit count-min sketch, halved after a sample period so old popularity fades */
+    struct FrequencySketch {
+        void Resize(size_t width);
+        void Increment(size_t hash);
+        uint32_t Estimate(size_t hash) const;
+        std::vector<uint8_t> counters;
+        size_t mask = 0;
+        size_t additions = 0;
+        size_t samplePeriod = 0;
+    };
+    struct Shard {
+        mutable std::mutex mutex;
+        std::list<Node> lru;
+        std::unordered_map<std::string_view, std::list<Node>::iterator> index;
+        FrequencySketch sketch;
+        size_t bytes = 0;
+        size_t budget = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+        uint64_t evictions = 0;
+        uint64_t rejections = 0;
+    };
+    Shard& ShardOf(std::string_view key, size_t& hash) const;
+    /** makes the connection report to the listener, returns the epoch to reserve with, 0 bypasses the cache */
+    uint64_t EnsureTracking(RedisClient& client);
+    uint64_t Reserve(const std::string& key, uint64_t epoch);
+    /** runs update on the node when the read that got token is still valid, then enforces the budget */
+    void Fill(const std::string& key, uint64_t token, const std::function<void(Node&)>& update);
+    void Invalidate(std::string_view key);
+    void Evict(Shard& shard, std::list<Node>::iterator it);
+    /** connects, reads the client id and subscribes, null on failure */
+    RedisClient::Ptr OpenListener(int64_t& id);
+    void Listen(RedisClient::Ptr listener, int64_t id);
+    bool Track(RedisClient::Ptr listener, int64_t id);
+    void Untrack();
+    static size_t NodeBytes(const Node& node);
+private:
+    RedisNearCacheOptions m_options;
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<bool> m_running {false};
+    std::atomic<uint64_t> m_tokens {0};
+    /** listener id and epoch change together on every (re)connect of the listener, epoch 0 is not tracking */
+    std::mutex m_stateMutex;
+    std::condition_variable m_stopCond;
+    int64_t m_listenerId = 0;
+    std::atomic<uint64_t> m_epoch {0};
+    std::string m_host;
+    uint16_t m_port = 0;
+    std::string m_password;
+    RedisClient::Ptr m_listener;
+    std::thread m_thread;
+    std::atomic<uint64_t> m_listenerFailures {0};
+};
+
+#endif // ! ____REDIS_CACHE_H____
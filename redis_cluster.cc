@@ -0,0 +1,364 @@
+#include "redis_cluster.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+namespace {
+constexpr uint32_t npos = UINT32_MAX;
+
+/** CRC16-CCITT (XModem), the key hash of Redis Cluster */
+const std::array<uint16_t, 256> s_crc16Table = []() {
+    std::array<uint16_t, 256> table {};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+uint16_t Crc16(std::string_view data) {
+    uint16_t crc = 0;
+    for (unsigned char c : data) {
+        crc = (uint16_t)((crc << 8) ^ s_crc16Table[((crc >> 8) ^ c) & 0xff]);
+    }
+    return crc;
+}
+
+int64_t NowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool StartsWith(std::string_view text, std::string_view prefix) {
+    return text.substr(0, prefix.size()) == prefix;
+}
+
+bool IsKeyless(std::string_view command, size_t argc) {
+    return argc < 2 || command == "KEYS" || command == "RANDOMKEY";
+}
+}
+
+RedisClusterClient::RedisClusterClient(const RedisClusterOptions& options)
+    : m_options (options) {
+}
+bool RedisClusterClient::Connect() {
+    for (auto& [host, port] : m_options.seeds) {
+        if (LoadSlots(host, port)) {
+            return true;
+        }
+    }
+    return false;
+}
+bool RedisClusterClient::Refresh() {
+    std::unique_lock lock(m_refreshMutex, std::try_to_lock);
+    if (!lock) {
+        /** somebody else is loading the map right now */
+        return false;
+    }
+    m_lastRefresh = NowMs();
+    if (auto topology = Load()) {
+        for (auto& node : topology->nodes) {
+            auto colon = node.name.rfind(':');
+            if (LoadSlots(node.name.substr(0, colon), (uint16_t)std::stoi(node.name.substr(colon + 1)))) {
+                return true;
+            }
+        }
+    }
+    for (auto& [host, port] : m_options.seeds) {
+        if (LoadSlots(host, port)) {
+            return true;
+        }
+    }
+    return false;
+}
+std::vector<std::string> RedisClusterClient::Nodes() const {
+    std::vector<std::string> nodes;
+    if (auto topology = Load()) {
+        for (auto& node : topology->nodes) {
+            nodes.push_back(node.name);
+        }
+    }
+    return nodes;
+}
+RedisClusterStats RedisClusterClient::Stats() const {
+    RedisClusterStats stats;
+    stats.pipeline_errors = m_pipelineErrors.load(std::memory_order_relaxed);
+    stats.slot_load_failures = m_slotLoadFailures.load(std::memory_order_relaxed);
+    return stats;
+}
+uint16_t RedisClusterClient::Slot(std::string_view key) {
+    /** only the part inside the first {...} is hashed when it is not empty, so related keys can share a slot */
+    if (auto open = key.find('{'); open != std::string_view::npos) {
+        if (auto close = key.find('}', open + 1); close != std::string_view::npos && close != open + 1) {
+            key = key.substr(open + 1, close - open - 1);
+        }
+    }
+    return Crc16(key) & (SlotCount - 1);
+}
+RedisReplyPtr RedisClusterClient::Command(const std::vector<std::string_view>& argv) {
+    return Execute(argv.data(), argv.size());
+}
+void RedisClusterClient::SplitMget(const std::vector<std::string>& keys
+        , std::vector<std::vector<std::string_view>>& batches, std::vector<std::vector<size_t>>& positions) {
+    batches.clear();
+    positions.clear();
+    std::unordered_map<uint16_t, size_t> bySlot;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto [it, added] = bySlot.try_emplace(Slot(keys[i]), batches.size());
+        if (added) {
+            batches.push_back({"MGET"});
+            positions.emplace_back();
+        }
+        batches[it->second].emplace_back(keys[i]);
+        positions[it->second].push_back(i);
+    }
+}
+std::vector<std::vector<std::string_view>> RedisClusterClient::SplitMset(const std::vector<std::pair<std::string, std::string>>& values) {
+    std::vector<std::vector<std::string_view>> batches;
+    std::unordered_map<uint16_t, size_t> bySlot;
+    for (auto& [key, value] : values) {
+        auto [it, added] = bySlot.try_emplace(Slot(key), batches.size());
+        if (added) {
+            batches.push_back({"MSET"});
+        }
+        batches[it->second].emplace_back(key);
+        batches[it->second].emplace_back(value);
+    }
+    return batches;
+}
+std::optional<RedisClusterClient::Redirect> RedisClusterClient::ParseRedirect(std::string_view error) {
+    Redirect redirect;
+    if (StartsWith(error, "ASK ")) {
+        redirect.ask = true;
+    } else if (!StartsWith(error, "MOVED ")) {
+        return std::nullopt;
+    }
+    auto slot = error.find(' ') + 1;
+    auto space = error.find(' ', slot);
+    if (space == std::string_view::npos || space + 1 >= error.size()) {
+        return std::nullopt;
+    }
+    uint32_t value = 0;
+    auto [end, ec] = std::from_chars(error.data() + slot, error.data() + space, value);
+    if (ec != std::errc() || end != error.data() + space || value >= SlotCount) {
+        return std::nullopt;
+    }
+    redirect.slot = (uint16_t)value;
+    redirect.target = std::string(error.substr(space + 1));
+    return redirect;
+}
+std::vector<std::optional<std::string>> RedisClusterClient::mget(const std::vector<std::string>& keys) {
+    std::vector<std::vector<std::string_view>> batches;
+    std::vector<std::vector<size_t>> positions;
+    SplitMget(keys, batches, positions);
+    auto replies = ExecuteBatches(batches);
+    std::vector<std::optional<std::string>> values(keys.size());
+    for (size_t b = 0; b < batches.size(); ++b) {
+        auto batch = RedisReplyConverter::OptionalStringArray(replies[b].get(), "MGET");
+        for (size_t j = 0; j < batch.size() && j < positions[b].size(); ++j) {
+            values[positions[b][j]] = std::move(batch[j]);
+        }
+    }
+    return values;
+}
+bool RedisClusterClient::mset(const std::vector<std::pair<std::string, std::string>>& values) {
+    auto batches = SplitMset(values);
+    auto replies = ExecuteBatches(batches);
+    bool ok = true;
+    for (auto& reply : replies) {
+        ok = RedisReplyConverter::Status(reply.get(), "MSET") && ok;
+    }
+    return ok;
+}
+RedisReplyPtr RedisClusterClient::Execute(const std::string_view* argv, size_t argc) {
+    std::vector<std::string_view> command(argv, argv + argc);
+    auto keyless = IsKeyless(argv[0], argc);
+    auto slot = keyless ? 0 : Slot(argv[1]);
+    auto route = [&]() -> RedisConnectPool::Ptr {
+        auto topology = Load();
+        if (!topology || topology->nodes.empty()) {
+            throw std::runtime_error("redis cluster without slot map, command : " + std::string(argv[0]));
+        }
+        if (keyless) {
+            return topology->nodes[m_roundRobin.fetch_add(1, std::memory_order_relaxed) % topology->nodes.size()].pool;
+        }
+        auto node = topology->slots[slot];
+        if (node == npos) {
+            throw std::runtime_error("redis cluster slot " + std::to_string(slot) + " is not served");
+        }
+        return topology->nodes[node].pool;
+    };
+
+    auto pool = route();
+    bool asking = false;
+    for (int32_t hop = 0; ; ++hop) {
+        RedisReplyPtr reply;
+        {
+            RedisConnectPoolGuard guard(pool.get());
+            auto conn = guard.Get(m_options.checkout_timeout);
+            if (asking) {
+                conn->CommandArgv({"ASKING"});
+            }
+            reply = conn->CommandArgv(command);
+        }
+        asking = false;
+        if (hop >= m_options.max_redirects) {
+            return reply;
+        }
+        if (!reply) {
+            /** the node may be gone after a failover, ask the cluster again */
+            Refresh();
+            pool = route();
+            continue;
+        }
+        if (reply->type != REDIS_REPLY_ERROR) {
+            return reply;
+        }
+        std::string_view error(reply->str, reply->len);
+        if (auto redirect = ParseRedirect(error)) {
+            /** the slot lives on another node from now on (MOVED) or for this command (ASK) */
+            if (!redirect->ask) {
+                if (NowMs() - m_lastRefresh.load() > 100) {
+                    Refresh();
+                }
+            } else {
+                asking = true;
+            }
+            pool = PoolOf(redirect->target);
+            continue;
+        }
+        if (StartsWith(error, "TRYAGAIN") || StartsWith(error, "CLUSTERDOWN")) {
+            /** resharding or failover in progress */
+            std::this_thread::sleep_for(std::chrono::milliseconds(10 * (hop + 1)));
+            pool = route();
+            continue;
+        }
+        return reply;
+    }
+}
+std::vector<RedisReplyPtr> RedisClusterClient::ExecuteBatches(const std::vector<std::vector<std::string_view>>& batches) {
+    std::vector<RedisReplyPtr> replies(batches.size());
+    auto topology = Load();
+    if (!topology) {
+        throw std::runtime_error("redis cluster without slot map, command : " + std::string(batches.empty() ? "" : batches[0][0]));
+    }
+    std::unordered_map<uint32_t, std::vector<size_t>> byNode;
+    for (size_t b = 0; b < batches.size(); ++b) {
+        byNode[topology->slots[Slot(batches[b][1])]].push_back(b);
+    }
+
+    struct InFlight {
+        explicit InFlight(RedisConnectPool* pool) : guard (pool) {}
+        RedisConnectPoolGuard guard;
+        std::unique_ptr<RedisPipeline> pipeline;
+        std::vector<std::pair<size_t, std::future<RedisReplyPtr>>> futures;
+    };
+    {
+        /** every node gets its pipeline written before any reply is read, so the nodes work in parallel */
+        std::vector<std::unique_ptr<InFlight>> inflight;
+        for (auto& [node, indexes] : byNode) {
+            if (node == npos) {
+                continue;
+            }
+            auto flight = std::make_unique<InFlight>(topology->nodes[node].pool.get());
+            flight->pipeline = std::make_unique<RedisPipeline>(flight->guard.Get(m_options.checkout_timeout));
+            for (auto b : indexes) {
+                flight->futures.emplace_back(b, flight->pipeline->Command(batches[b]));
+            }
+            flight->pipeline->Flush();
+            inflight.push_back(std::move(flight));
+        }
+        for (auto& flight : inflight) {
+            try {
+                flight->pipeline->Exec();
+            } catch (const std::exception& e) {
+                m_pipelineErrors.fetch_add(1, std::memory_order_relaxed);
+                RedisReportError(m_options.error_handler, "pipeline", e);
+            }
+            for (auto& [b, future] : flight->futures) {
+                try {
+                    replies[b] = future.get();
+                } catch (const std::exception&) {
+                    /** left null, the batch is routed again below */
+                }
+            }
+        }
+    }
+
+    /** batches that hit a moved slot, a lost connection or an unserved slot go the single command way */
+    for (size_t b = 0; b < batches.size(); ++b) {
+        auto& reply = replies[b];
+        if (!reply || (reply->type == REDIS_REPLY_ERROR && (StartsWith(reply->str, "MOVED ")
+            || StartsWith(reply->str, "ASK ") || StartsWith(reply->str, "TRYAGAIN") || StartsWith(reply->str, "CLUSTERDOWN")))) {
+            reply = Execute(batches[b].data(), batches[b].size());
+        }
+    }
+    return replies;
+}
+RedisConnectPool::Ptr RedisClusterClient::PoolOf(const std::string& name) {
+    std::shared_ptr<NodePool> node;
+    {
+        std::lock_guard guard(m_poolMutex);
+        auto& entry = m_pools[name];
+        if (!entry) {
+            entry = std::make_shared<NodePool>();
+        }
+        node = entry;
+    }
+    /** connected outside the lock, a slow node only holds up the callers routed to it */
+    std::call_once(node->connected, [this, &name, &node]() {
+        auto colon = name.rfind(':');
+        auto options = m_options.pool;
+        options.host = name.substr(0, colon);
+        options.port = (uint16_t)std::stoi(name.substr(colon + 1));
+        options.password = m_options.password;
+        node->pool->Connect(options);
+    });
+    return node->pool;
+}
+bool RedisClusterClient::LoadSlots(const std::string& host, uint16_t port) {
+    RedisReplyPtr reply;
+    try {
+        auto pool = PoolOf(host + ":" + std::to_string(port));
+        RedisConnectPoolGuard guard(pool.get());
+        reply = guard.Get(m_options.checkout_timeout)->CommandArgv({"CLUSTER", "SLOTS"});
+    } catch (const std::exception& e) {
+        m_slotLoadFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "slots", e);
+        return false;
+    }
+    if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements == 0) {
+        return false;
+    }
+    auto topology = std::make_shared<Topology>();
+    topology->slots.fill(npos);
+    std::unordered_map<std::string, uint32_t> indexes;
+    for (size_t i = 0; i < reply->elements; ++i) {
+        /** [start, end, [ip, port, id], replicas ...], the first node is the master */
+        auto range = reply->element[i];
+        if (range->type != REDIS_REPLY_ARRAY || range->elements < 3 || range->element[2]->type != REDIS_REPLY_ARRAY
+            || range->element[2]->elements < 2) {
+            continue;
+        }
+        auto master = range->element[2];
+        std::string ip(master->element[0]->str, master->element[0]->len);
+        auto name = (ip.empty() ? host : ip) + ":" + std::to_string(master->element[1]->integer);
+        auto [it, added] = indexes.try_emplace(name, (uint32_t)topology->nodes.size());
+        if (added) {
+            topology->nodes.push_back({name, PoolOf(name)});
+        }
+        auto start = std::max<long long>(range->element[0]->integer, 0);
+        auto end = std::min<long long>(range->element[1]->integer, SlotCount - 1);
+        for (auto slot = start; slot <= end; ++slot) {
+            topology->slots[slot] = it->second;
+        }
+    }
+    if (topology->nodes.empty()) {
+        return false;
+    }
+    std::atomic_store(&m_topology, std::shared_ptr<const Topology>(std::move(topology)));
+    return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file redis_cluster.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-07
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_CLUSTER_H____
+#define ____REDIS_CLUSTER_H____
+
+#include "redis.h"
+
+struct RedisClusterOptions {
+    /** any reachable subset of the nodes, the rest is learned from CLUSTER SLOTS */
+    std::vector<std::pair<std::string, uint16_t>> seeds;
+    std::string password;
+    /** template of every per node pool, host, port and password are filled in */
+    RedisConnectPoolOptions pool;
+    /** how long a command waits for a connection of its node */
+    std::chrono::milliseconds checkout_timeout {100};
+    /** MOVED / ASK / TRYAGAIN hops before a command fails */
+    int32_t max_redirects = 5;
+    /** optional, receives what the stats count, on the thread that hit it */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisClusterStats {
+    /** node pipelines of mget / mset that failed, their batches were sent again one by one */
+    uint64_t pipeline_errors = 0;
+    /** CLUSTER SLOTS that could not be sent to a node */
+    uint64_t slot_load_failures = 0;
+};
+
+/**
+ * @brief client of a Redis Cluster, commands are routed by the CRC16 hash slot of their key
+ *        (argv[1], or the {hash tag} in it) to a connection pool of the node serving the slot.
+ *        MOVED refreshes the slot map, ASK is followed once with ASKING.
+ *        mget / mset are split by slot and sent as one pipeline per node, all nodes in flight at once.
+ *        multi key commands other than mget / mset need their keys in one slot, use hash tags.
+ *        commands without a key (KEYS, RANDOMKEY) run on a single node.
+ */
+class RedisClusterClient final : public RedisCommands<RedisClusterClient> {
+    friend class RedisCommands<RedisClusterClient>;
+public:
+    using Ptr = std::shared_ptr<RedisClusterClient>;
+    static constexpr uint32_t SlotCount = 16384;
+
+    explicit RedisClusterClient(const RedisClusterOptions& options);
+    /** loads the slot map from the first seed that answers */
+    bool Connect();
+    /** reloads the slot map, at most one thread does it at a time */
+    bool Refresh();
+    /** nodes serving at least one slot, "host:port" */
+    std::vector<std::string> Nodes() const;
+    RedisClusterStats Stats() const;
+
+    static uint16_t Slot(std::string_view key);
+    /** keys grouped by slot in order of first appearance, one "MGET" argv per slot and the key positions of each */
+    static void SplitMget(const std::vector<std::string>& keys
+        , std::vector<std::vector<std::string_view>>& batches, std::vector<std::vector<size_t>>& positions);
+    /** pairs grouped by slot in order of first appearance, one "MSET" argv per slot */
+    static std::vector<std::vector<std::string_view>> SplitMset(const std::vector<std::pair<std::string, std::string>>& values);
+    /** where a MOVED or ASK error reply points */
+    struct Redirect {
+        bool ask = false;
+        uint16_t slot = 0;
+        /** "host:port" */
+        std::string target;
+    };
+    /** "MOVED 3999 127.0.0.1:6381" or "ASK 3999 127.0.0.1:6381", nullopt for any other error */
+    static std::optional<Redirect> ParseRedirect(std::string_view error);
+
+    /** routed by argv[1], redirects are followed, the reply may be an error reply */
+    RedisReplyPtr Command(const std::vector<std::string_view>& argv);
+
+    /** MGET            */ std::vector<std::optional<std::string>> mget(const std::vector<std::string>& keys);
+    /** MSET            */ bool mset(const std::vector<std::pair<std::string, std::string>>& values);
+protected:
+    template <typename T>
+    T Submit(RedisConvertFunc<T> convert, const std::string_view* argv, size_t argc) {
+        auto reply = Execute(argv, argc);
+        return convert(reply.get(), argv[0].data());
+    }
+private:
+    struct Node {
+        std::string name;
+        RedisConnectPool::Ptr pool;
+    };
+    /** immutable, replaced as a whole by Refresh */
+    struct Topology {
+        std::vector<Node> nodes;
+        std::array<uint32_t, SlotCount> slots;
+    };
+    RedisReplyPtr Execute(const std::string_view* argv, size_t argc);
+    /** runs one batch per slot, batches of the same node share a pipeline, replies in batch order */
+    std::vector<RedisReplyPtr> ExecuteBatches(const std::vector<std::vector<std::string_view>>& batches);
+    RedisConnectPool::Ptr PoolOf(const std::string& name);
+    std::shared_ptr<const Topology> Load() const { return std::atomic_load(&m_topology); }
+    bool LoadSlots(const std::string& host, uint16_t port);
+private:
+    RedisClusterOptions m_options;
+    std::shared_ptr<const Topology> m_topology;
+    struct NodePool {
+        RedisConnectPool::Ptr pool = std::make_shared<RedisConnectPool>();
+        std::once_flag connected;
+    };
+    mutable std::mutex m_poolMutex;
+    std::unordered_map<std::string, std::shared_ptr<NodePool>> m_pools;
+    std::mutex m_refreshMutex;
+    std::atomic<int64_t> m_lastRefresh {0};
+    std::atomic<uint64_t> m_roundRobin {0};
+    std::atomic<uint64_t> m_pipelineErrors {0};
+    std::atomic<uint64_t> m_slotLoadFailures {0};
+};
+
+#endif // ! ____REDIS_CLUSTER_H____
@@ -0,0 +1,140 @@
+#include "redis_coalesce.h"
+
+RedisCoalescer::RedisCoalescer(RedisConnectPool* pool, const RedisCoalescerOptions& options)
+    : m_pool (pool), m_options (options) {
+    m_options.max_batch = std::max<size_t>(m_options.max_batch, 1);
+}
+std::optional<std::string> RedisCoalescer::get(const std::string& key) {
+    Request request {Kind::get, key};
+    Submit(request);
+    return std::move(request.value);
+}
+std::optional<std::string> RedisCoalescer::hget(const std::string& key, const std::string& field) {
+    Request request {Kind::hget, key, &field};
+    Submit(request);
+    return std::move(request.value);
+}
+bool RedisCoalescer::exists(const std::string& key) {
+    Request request {Kind::exists, key};
+    Submit(request);
+    return request.exists;
+}
+RedisCoalescerStats RedisCoalescer::Stats() const {
+    RedisCoalescerStats stats;
+    stats.requests = m_requests.load(std::memory_order_relaxed);
+    stats.batches = m_batches.load(std::memory_order_relaxed);
+    return stats;
+}
+void RedisCoalescer::Submit(Request& request) {
+    m_requests.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock lock(m_mutex);
+    if (m_open) {
+        /** follower, the leader of the open batch sends our request */
+        auto batch = m_open;
+        batch->requests.push_back(&request);
+        if (batch->requests.size() >= m_options.max_batch) {
+            m_open.reset();
+            batch->full.notify_one();
+        }
+        batch->done.wait(lock, [&batch]() { return batch->finished; });
+    } else {
+        auto batch = std::make_shared<Batch>();
+        batch->requests.push_back(&request);
+        /** alone on the wire nothing is gained by waiting, others join while an earlier batch is in flight */
+        if (m_options.max_batch > 1 && m_executing != 0) {
+            m_open = batch;
+            batch->full.wait_for(lock, m_options.window, [this, &batch]() { return m_open != batch || m_executing == 0; });
+            if (m_open == batch) {
+                m_open.reset();
+            }
+        }
+        /** closed, nobody touches the request list any more */
+        ++m_executing;
+        lock.unlock();
+        Execute(batch->requests);
+        lock.lock();
+        if (--m_executing == 0 && m_open) {
+            m_open->full.notify_one();
+        }
+        batch->finished = true;
+        batch->done.notify_all();
+    }
+    lock.unlock();
+    if (request.error) {
+        std::rethrow_exception(request.error);
+    }
+}
+void RedisCoalescer::Execute(const std::vector<Request*>& requests) {
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    try {
+        RedisConnectPoolGuard guard(m_pool);
+        RedisPipeline pipeline(guard.Get(m_options.checkout_timeout));
+
+        /** every GET goes into one MGET, a key asked for twice is sent once */
+        std::vector<std::string> keys;
+        std::unordered_map<std::string_view, size_t> positions;
+        std::vector<size_t> slots(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (requests[i]->kind == Kind::get) {
+                auto [it, added] = positions.try_emplace(requests[i]->key, keys.size());
+                if (added) {
+                    keys.push_back(requests[i]->key);
+                }
+                slots[i] = it->second;
+            }
+        }
+        std::future<std::vector<std::optional<std::string>>> values;
+        if (!keys.empty()) {
+            values = pipeline.mget(keys);
+        }
+        std::vector<std::future<std::optional<std::string>>> fields(requests.size());
+        std::vector<std::future<bool>> exists(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (requests[i]->kind == Kind::hget) {
+                fields[i] = pipeline.hget(requests[i]->key, *requests[i]->field);
+            } else if (requests[i]->kind == Kind::exists) {
+                exists[i] = pipeline.exists(requests[i]->key);
+            }
+        }
+        pipeline.Exec();
+
+        std::vector<std::optional<std::string>> mget;
+        std::exception_ptr mgetError;
+        if (values.valid()) {
+            try {
+                mget = values.get();
+            } catch (...) {
+                mgetError = std::current_exception();
+            }
+        }
+        for (size_t i = 0; i < requests.size(); ++i) {
+            auto& request = *requests[i];
+            try {
+                switch (request.kind) {
+                case Kind::get:
+                    if (mgetError) {
+                        std::rethrow_exception(mgetError);
+                    }
+                    request.value = slots[i] < mget.size() ? mget[slots[i]] : std::nullopt;
+                    break;
+                case Kind::hget:
+                    request.value = fields[i].get();
+                    break;
+                case Kind::exists:
+                    request.exists = exists[i].get();
+                    break;
+                }
+            } catch (...) {
+                request.error = std::current_exception();
+            }
+        }
+    } catch (...) {
+        /** no connection or a broken one, the whole batch fails */
+        auto error = std::current_exception();
+        for (auto request : requests) {
+            if (!request->error) {
+                request->error = error;
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file redis_coalesce.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-08
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_COALESCE_H____
+#define ____REDIS_COALESCE_H____
+
+#include "redis.h"
+
+struct RedisCoalescerOptions {
+    /** how long the first request of a batch waits for others to join while an earlier batch is in flight */
+    std::chrono::microseconds window {100};
+    /** a batch is sent at once when it holds this many requests */
+    size_t max_batch = 128;
+    /** how long a batch waits for a connection of the pool */
+    std::chrono::milliseconds checkout_timeout {100};
+};
+
+struct RedisCoalescerStats {
+    uint64_t requests = 0;
+    /** one checkout and one round trip each */
+    uint64_t batches = 0;
+};
+
+/**
+ * @brief front end that merges concurrent single key reads into one round trip.
+ *        the first caller of a batch leads it. with no batch in flight it sends at once, otherwise it waits
+ *        until that batch is done, the window is over or the batch is full, so an uncontended call pays nothing.
+ *        the leader checks out one connection and sends every GET of the batch as one MGET followed by the
+ *        HGET and EXISTS commands in the same pipeline. the other callers block until the leader
+ *        has filled in their results, requests arriving meanwhile form the next batch.
+ *        e.g. RedisCoalescer coalescer; auto value = coalescer.get("user:1");
+ */
+class RedisCoalescer final {
+public:
+    explicit RedisCoalescer(RedisConnectPool* pool = RedisConnectPool::Instance().get()
+        , const RedisCoalescerOptions& options = RedisCoalescerOptions());
+    RedisCoalescer(const RedisCoalescer&) = delete;
+    RedisCoalescer& operator=(const RedisCoalescer&) = delete;
+
+    /** GET             */ std::optional<std::string> get(const std::string& key);
+    /** HGET            */ std::optional<std::string> hget(const std::string& key, const std::string& field);
+    /** EXISTS          */ bool exists(const std::string& key);
+
+    RedisCoalescerStats Stats() const;
+private:
+    enum class Kind : int8_t {
+        get,
+        hget,
+        exists
+    };
+    /** lives on the stack of its caller, who blocks until the batch is done */
+    struct Request {
+        Kind kind;
+        const std::string& key;
+        const std::string* field = nullptr;
+        std::optional<std::string> value {};
+        bool exists = false;
+        std::exception_ptr error {};
+    };
+    struct Batch {
+        std::vector<Request*> requests;
+        std::condition_variable full;
+        std::condition_variable done;
+        bool finished = false;
+    };
+    /** joins or leads the open batch, returns once request is filled in, rethrows its error */
+    void Submit(Request& request);
+    void Execute(const std::vector<Request*>& requests);
+private:
+    RedisConnectPool* m_pool;
+    RedisCoalescerOptions m_options;
+    std::mutex m_mutex;
+    std::shared_ptr<Batch> m_open;
+    /** batches sent and not yet done, guarded by m_mutex */
+    size_t m_executing = 0;
+    std::atomic<uint64_t> m_requests {0};
+    std::atomic<uint64_t> m_batches {0};
+};
+
+#endif // ! ____REDIS_COALESCE_H____
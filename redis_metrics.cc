@@ -0,0 +1,348 @@
+#include "redis_metrics.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <sys/types.h>
+
+std::atomic<bool> RedisMetrics::s_enabled {true};
+
+namespace {
+
+constexpr size_t kMaxCommands = 256;
+/** commands beyond kMaxCommands - 1 distinct names are counted here */
+constexpr size_t kOther = kMaxCommands - 1;
+constexpr size_t kNameLength = 32;
+
+/** counters of one command in one thread, only that thread writes, Snapshot reads */
+struct Slot {
+    std::atomic<uint64_t> calls {0};
+    std::atomic<uint64_t> errors {0};
+    std::atomic<uint64_t> bytesOut {0};
+    std::atomic<uint64_t> bytesIn {0};
+    std::atomic<uint64_t> totalNanos {0};
+    std::atomic<uint64_t> maxNanos {0};
+    std::array<std::atomic<uint64_t>, RedisLatencyHistogram::kBuckets> counts {};
+};
+
+struct Shard {
+    std::array<std::atomic<Slot*>, kMaxCommands> slots {};
+    ~Shard() {
+        for (auto& slot : slots) {
+            delete slot.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<Shard*> shards;
+    std::unordered_map<std::string, size_t> ids;
+    std::vector<std::string> names;
+    /** what threads recorded before they exited, by command id */
+    std::vector<RedisCommandStats> retired;
+};
+
+Registry& GetRegistry() {
+    /** never destroyed, threads still record while static destructors run */
+    static auto registry = new Registry();
+    return *registry;
+}
+
+/** single writer, a plain load and store is enough and keeps the lock prefix off the hot path */
+void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Merge(const Slot& slot, RedisCommandStats& stats) {
+    stats.calls += slot.calls.load(std::memory_order_relaxed);
+    stats.errors += slot.errors.load(std::memory_order_relaxed);
+    stats.bytes_out += slot.bytesOut.load(std::memory_order_relaxed);
+    stats.bytes_in += slot.bytesIn.load(std::memory_order_relaxed);
+    stats.total_nanos += slot.totalNanos.load(std::memory_order_relaxed);
+    stats.max_nanos = std::max(stats.max_nanos, slot.maxNanos.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < RedisLatencyHistogram::kBuckets; ++i) {
+        auto count = slot.counts[i].load(std::memory_order_relaxed);
+        stats.latency.counts[i] += count;
+        stats.latency.count += count;
+    }
+}
+
+/** set once the shard of this thread is folded away, a command sent later from a thread_local destructor is not counted */
+thread_local bool t_retired = false;
+
+/** the shard of one thread, folded into Registry::retired and freed when the thread exits */
+class ShardOwner {
+public:
+    ShardOwner() : m_shard (std::make_unique<Shard>()) {
+        auto& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.shards.push_back(m_shard.get());
+    }
+    ~ShardOwner() {
+        auto& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        for (size_t id = 0; id < kMaxCommands; ++id) {
+            if (auto slot = m_shard->slots[id].load(std::memory_order_relaxed)) {
+                if (registry.retired.size() <= id) {
+                    registry.retired.resize(kMaxCommands);
+                }
+                Merge(*slot, registry.retired[id]);
+            }
+        }
+        registry.shards.erase(std::find(registry.shards.begin(), registry.shards.end(), m_shard.get()));
+        t_retired = true;
+    }
+    Shard& Get() { return *m_shard; }
+private:
+    std::unique_ptr<Shard> m_shard;
+};
+
+Shard* LocalShard() {
+    if (t_retired) {
+        return nullptr;
+    }
+    thread_local ShardOwner owner;
+    return &owner.Get();
+}
+
+size_t CommandId(std::string_view command) {
+    char upper[kNameLength];
+    auto length = std::min(command.size(), kNameLength);
+    for (size_t i = 0; i < length; ++i) {
+        upper[i] = (char)std::toupper((unsigned char)command[i]);
+    }
+    /** short names stay in the small string buffer, the lookup does not allocate */
+    std::string name(upper, length);
+    thread_local std::unordered_map<std::string, size_t> cache;
+    if (auto it = cache.find(name); it != cache.end()) {
+        return it->second;
+    }
+    auto& registry = GetRegistry();
+    size_t id;
+    {
+        std::lock_guard guard(registry.mutex);
+        if (registry.names.empty()) {
+            registry.names.resize(kMaxCommands);
+            registry.names[kOther] = "OTHER";
+        }
+        auto it = registry.ids.find(name);
+        if (it != registry.ids.end()) {
+            id = it->second;
+        } else if (registry.ids.size() < kOther) {
+            id = registry.ids.size();
+            registry.ids.emplace(name, id);
+            registry.names[id] = name;
+        } else {
+            id = kOther;
+        }
+    }
+    cache.emplace(std::move(name), id);
+    return id;
+}
+
+size_t Digits(uint64_t value) {
+    size_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        ++digits;
+    }
+    return digits;
+}
+
+/** read hooks of one kind of context (plain TCP, unix socket ...), never freed, contexts keep pointing at them */
+struct CountingFuncs {
+    /** first member, a context pointing at funcs is cast back to reach original */
+    redisContextFuncs funcs;
+    const redisContextFuncs* original;
+};
+
+thread_local uint64_t t_bytesRead = 0;
+
+ssize_t CountingRead(redisContext* context, char* buffer, size_t size) {
+    auto counting = reinterpret_cast<const CountingFuncs*>(context->funcs);
+    auto n = counting->original->read(context, buffer, size);
+    if (n > 0) {
+        t_bytesRead += n;
+    }
+    return n;
+}
+
+}
+
+size_t RedisLatencyHistogram::BucketOf(uint64_t nanos) {
+    if (nanos < kSubBuckets) {
+        return nanos;
+    }
+    size_t octave = 63 - __builtin_clzll(nanos);
+    if (octave >= kOctaves + 3) {
+        return kBuckets - 1;
+    }
+    return (octave - 3) * kSubBuckets + ((nanos >> (octave - 4)) & (kSubBuckets - 1));
+}
+uint64_t RedisLatencyHistogram::LowerBound(size_t bucket) {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    auto octave = bucket / kSubBuckets + 3;
+    return (kSubBuckets + bucket % kSubBuckets) << (octave - 4);
+}
+uint64_t RedisLatencyHistogram::Percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    auto target = std::max<uint64_t>(1, (uint64_t)std::ceil(std::clamp(p, 0.0, 1.0) * count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            /** the highest value the bucket stands for */
+            return i + 1 < kBuckets ? LowerBound(i + 1) - 1 : LowerBound(i);
+        }
+    }
+    return LowerBound(kBuckets - 1);
+}
+
+RedisMetricsSnapshot RedisMetricsSnapshot::Since(const RedisMetricsSnapshot& earlier) const {
+    RedisMetricsSnapshot delta;
+    delta.at = at;
+    for (auto& current : commands) {
+        auto stats = current;
+        auto it = std::find_if(earlier.commands.begin(), earlier.commands.end()
+            , [&current](const RedisCommandStats& before) { return before.command == current.command; });
+        if (it != earlier.commands.end()) {
+            stats.calls -= it->calls;
+            stats.errors -= it->errors;
+            stats.bytes_out -= it->bytes_out;
+            stats.bytes_in -= it->bytes_in;
+            stats.total_nanos -= it->total_nanos;
+            stats.latency.count -= it->latency.count;
+            for (size_t i = 0; i < RedisLatencyHistogram::kBuckets; ++i) {
+                stats.latency.counts[i] -= it->latency.counts[i];
+            }
+        }
+        if (stats.calls) {
+            delta.commands.push_back(std::move(stats));
+        }
+    }
+    std::sort(delta.commands.begin(), delta.commands.end()
+        , [](const RedisCommandStats& l, const RedisCommandStats& r) { return l.calls > r.calls; });
+    return delta;
+}
+std::string RedisMetricsSnapshot::ToString() const {
+    std::string text;
+    char line[256];
+    for (auto& stats : commands) {
+        snprintf(line, sizeof(line), "%-16s calls %llu errors %llu out %llu in %llu"
+            " mean %.1f p50 %.1f p99 %.1f p999 %.1f max %.1f us\n"
+            , stats.command.c_str(), (unsigned long long)stats.calls, (unsigned long long)stats.errors
+            , (unsigned long long)stats.bytes_out, (unsigned long long)stats.bytes_in
+            , stats.MeanMicros(), stats.PercentileMicros(0.5), stats.PercentileMicros(0.99)
+            , stats.PercentileMicros(0.999), stats.max_nanos / 1000.0);
+        text += line;
+    }
+    return text;
+}
+
+RedisMetricsSnapshot RedisMetrics::Snapshot() {
+    RedisMetricsSnapshot snapshot;
+    std::vector<std::string> names;
+    std::vector<RedisCommandStats> commands;
+    {
+        /** held while the shards are read, an exiting thread folds its shard away only after */
+        auto& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        snapshot.at = std::chrono::steady_clock::now();
+        names = registry.names;
+        commands = registry.retired;
+        commands.resize(names.size());
+        for (auto shard : registry.shards) {
+            for (size_t id = 0; id < names.size(); ++id) {
+                if (auto slot = shard->slots[id].load(std::memory_order_acquire)) {
+                    Merge(*slot, commands[id]);
+                }
+            }
+        }
+    }
+    for (size_t id = 0; id < names.size(); ++id) {
+        if (commands[id].calls) {
+            commands[id].command = names[id];
+            snapshot.commands.push_back(std::move(commands[id]));
+        }
+    }
+    std::sort(snapshot.commands.begin(), snapshot.commands.end()
+        , [](const RedisCommandStats& l, const RedisCommandStats& r) { return l.calls > r.calls; });
+    return snapshot;
+}
+std::string_view RedisMetrics::CommandOf(const char* formatted, size_t length) {
+    /** *<argc>\r\n$<length>\r\n<command>\r\n */
+    std::string_view resp(formatted, length);
+    auto header = resp.find("\r\n$");
+    if (header == std::string_view::npos) {
+        return {};
+    }
+    auto start = resp.find("\r\n", header + 3);
+    if (start == std::string_view::npos) {
+        return {};
+    }
+    start += 2;
+    auto end = resp.find("\r\n", start);
+    return resp.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+}
+size_t RedisMetrics::RequestBytes(const std::vector<std::string_view>& argv) {
+    size_t bytes = 3 + Digits(argv.size());
+    for (auto argument : argv) {
+        bytes += 5 + Digits(argument.size()) + argument.size();
+    }
+    return bytes;
+}
+void RedisMetrics::CountReads(redisContext* context) {
+    if (!context || !context->funcs || context->funcs->read == &CountingRead) {
+        return;
+    }
+    static std::mutex mutex;
+    static std::vector<CountingFuncs*> wrapped;
+    std::lock_guard guard(mutex);
+    auto it = std::find_if(wrapped.begin(), wrapped.end()
+        , [context](const CountingFuncs* counting) { return counting->original == context->funcs; });
+    if (it == wrapped.end()) {
+        auto counting = new CountingFuncs {*context->funcs, context->funcs};
+        counting->funcs.read = &CountingRead;
+        it = wrapped.insert(wrapped.end(), counting);
+    }
+    context->funcs = &(*it)->funcs;
+}
+uint64_t RedisMetrics::BytesRead() {
+    return t_bytesRead;
+}
+void RedisMetrics::Record(std::string_view command, uint64_t nanos, size_t bytesOut, size_t bytesIn, const redisReply* reply) {
+    if (command.empty()) {
+        return;
+    }
+    auto shard = LocalShard();
+    if (!shard) {
+        return;
+    }
+    auto id = CommandId(command);
+    auto& slotRef = shard->slots[id];
+    auto slot = slotRef.load(std::memory_order_relaxed);
+    if (!slot) {
+        slot = new Slot();
+        slotRef.store(slot, std::memory_order_release);
+    }
+    Add(slot->calls, 1);
+    if (!reply || reply->type == REDIS_REPLY_ERROR) {
+        Add(slot->errors, 1);
+    }
+    Add(slot->bytesOut, bytesOut);
+    Add(slot->bytesIn, bytesIn);
+    Add(slot->totalNanos, nanos);
+    if (nanos > slot->maxNanos.load(std::memory_order_relaxed)) {
+        slot->maxNanos.store(nanos, std::memory_order_relaxed);
+    }
+    Add(slot->counts[RedisLatencyHistogram::BucketOf(nanos)], 1);
+}
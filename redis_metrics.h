@@ -0,0 +1,95 @@
+/**
+ * @file redis_metrics.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_METRICS_H____
+#define ____REDIS_METRICS_H____
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hiredis.h"
+
+/**
+ * @brief latency histogram with a bounded relative error, HDR style.
+ *        values below 16 are exact, above that every power of two is split into 16 buckets (6.25% wide)
+ */
+struct RedisLatencyHistogram {
+    static constexpr size_t kSubBuckets = 16;
+    static constexpr size_t kOctaves = 40;
+    static constexpr size_t kBuckets = kSubBuckets * kOctaves;
+    static size_t BucketOf(uint64_t nanos);
+    /** smallest value of a bucket */
+    static uint64_t LowerBound(size_t bucket);
+
+    std::array<uint64_t, kBuckets> counts {};
+    uint64_t count = 0;
+    /** nanoseconds at or below which the fraction p (0 - 1) of the calls completed, 0 without calls */
+    uint64_t Percentile(double p) const;
+};
+
+struct RedisCommandStats {
+    std::string command;
+    uint64_t calls = 0;
+    /** error replies and lost connections */
+    uint64_t errors = 0;
+    /** RESP bytes of the requests, and bytes read from the socket while waiting for the replies */
+    uint64_t bytes_out = 0;
+    uint64_t bytes_in = 0;
+    uint64_t total_nanos = 0;
+    uint64_t max_nanos = 0;
+    RedisLatencyHistogram latency;
+    double MeanMicros() const { return calls ? total_nanos / 1000.0 / calls : 0; }
+    double PercentileMicros(double p) const { return latency.Percentile(p) / 1000.0; }
+};
+
+struct RedisMetricsSnapshot {
+    std::chrono::steady_clock::time_point at;
+    /** every command seen so far, most called first */
+    std::vector<RedisCommandStats> commands;
+    /** what happened between earlier and this snapshot, max_nanos stays the all time maximum */
+    RedisMetricsSnapshot Since(const RedisMetricsSnapshot& earlier) const;
+    /** one line per command: calls, errors, bytes, mean / p50 / p99 / p999 / max in microseconds */
+    std::string ToString() const;
+};
+
+/**
+ * @brief per command counters of the synchronous RedisClient calls (Command, CommandArgv and all built on them).
+ *        every thread records into a shard of its own with plain stores, no lock and no shared cache line on
+ *        the hot path, Snapshot sums the shards. the shard of an exiting thread is folded into a global total and freed.
+ *        pipelines, transactions and the bulk loader are not timed per command.
+ *        e.g. auto before = RedisMetrics::Snapshot(); ... std::cout << RedisMetrics::Snapshot().Since(before).ToString();
+ */
+class RedisMetrics final {
+public:
+    /** on by default */
+    static void Enable(bool enabled) { s_enabled.store(enabled, std::memory_order_relaxed); }
+    static bool Enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static RedisMetricsSnapshot Snapshot();
+
+    /** the first argument of a command formatted as RESP */
+    static std::string_view CommandOf(const char* formatted, size_t length);
+    /** RESP size of a request */
+    static size_t RequestBytes(const std::vector<std::string_view>& argv);
+    /** wraps the socket reads of context so that BytesRead counts them, calling it again does nothing */
+    static void CountReads(redisContext* context);
+    /** bytes the calling thread has read from counted contexts so far */
+    static uint64_t BytesRead();
+    /** command is matched case insensitively, reply may be null for a lost connection */
+    static void Record(std::string_view command, uint64_t nanos, size_t bytesOut, size_t bytesIn, const redisReply* reply);
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif // ! ____REDIS_METRICS_H____
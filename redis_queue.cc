@@ -0,0 +1,195 @@
+#include "redis_queue.h"
+#include <algorithm>
+
+RedisQueueConsumer::RedisQueueConsumer(const RedisQueueConsumerOptions& options)
+    : m_options (options) {
+    m_options.batch = std::max<size_t>(m_options.batch, 1);
+    m_options.capacity = std::max<size_t>(m_options.capacity, 1);
+    m_options.workers = std::max<size_t>(m_options.workers, 1);
+    m_timeout = RedisArgument(m_options.block_seconds);
+    m_numkeys = RedisArgument(int64_t(m_options.queues.size()));
+}
+RedisQueueConsumer::~RedisQueueConsumer() {
+    Stop();
+}
+bool RedisQueueConsumer::Start(Handler handler) {
+    Stop();
+    if (m_options.queues.empty()) {
+        throw std::runtime_error("redis queue consumer without queue");
+    }
+    m_handler = std::move(handler);
+    auto connected = Open();
+    {
+        std::lock_guard guard(m_mutex);
+        m_running = true;
+        m_fetching = true;
+    }
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        m_workers.emplace_back(&RedisQueueConsumer::Work, this);
+    }
+    m_fetcher = std::thread(&RedisQueueConsumer::Fetch, this);
+    return connected;
+}
+void RedisQueueConsumer::Stop() {
+    {
+        std::lock_guard guard(m_mutex);
+        m_running = false;
+    }
+    m_spaceCond.notify_all();
+    /** the pop in flight may hold items already taken from redis, it is waited for, not cut off */
+    if (m_fetcher.joinable()) {
+        m_fetcher.join();
+    }
+    {
+        std::lock_guard guard(m_mutex);
+        m_fetching = false;
+    }
+    m_itemCond.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+}
+RedisQueueConsumerStats RedisQueueConsumer::Stats() const {
+    RedisQueueConsumerStats stats;
+    stats.round_trips = m_roundTrips.load(std::memory_order_relaxed);
+    stats.popped = m_popped.load(std::memory_order_relaxed);
+    stats.handled = m_handled.load(std::memory_order_relaxed);
+    stats.failed = m_failed.load(std::memory_order_relaxed);
+    stats.connect_failures = m_connectFailures.load(std::memory_order_relaxed);
+    stats.errors = m_errors.load(std::memory_order_relaxed);
+    std::lock_guard guard(m_mutex);
+    stats.queued = m_items.size();
+    return stats;
+}
+bool RedisQueueConsumer::Open() {
+    auto client = std::make_shared<RedisClient>();
+    try {
+        if (!client->ConnectWithTimeout(m_options.host, m_options.port, m_options.connect_timeout_ms, m_options.password)) {
+            throw std::runtime_error("redis queue consumer connect error:( " + m_options.host + " : " + std::to_string(m_options.port));
+        }
+    } catch (const std::exception& e) {
+        m_connectFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "connect", e);
+        return false;
+    }
+    m_client = client;
+    return true;
+}
+void RedisQueueConsumer::Fetch() {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    while (true) {
+        size_t room;
+        {
+            std::unique_lock lock(m_mutex);
+            m_spaceCond.wait(lock, [this]() { return !m_running || m_items.size() < m_options.capacity; });
+            if (!m_running) {
+                return;
+            }
+            room = m_options.capacity - m_items.size();
+        }
+        if (m_client && !m_client->IsBroken()) {
+            try {
+                if (Pop(std::min(room, m_options.batch), !m_backlog)) {
+                    backoff = m_options.reconnect_backoff_min_ms;
+                    continue;
+                }
+            } catch (const std::exception& e) {
+                /** WRONGTYPE, LOADING, READONLY ... the connection is dropped and retried after a backoff */
+                m_errors.fetch_add(1, std::memory_order_relaxed);
+                RedisReportError(m_options.error_handler, "pop", e);
+            }
+        }
+        m_client.reset();
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_spaceCond.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return !m_running; })) {
+                return;
+            }
+        }
+        backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+        Open();
+    }
+}
+bool RedisQueueConsumer::Pop(size_t count, bool block) {
+    m_argv.clear();
+    if (m_multiPop) {
+        /** [B]LMPOP [timeout] numkeys key ... LEFT|RIGHT COUNT count */
+        m_argv.push_back(block ? "BLMPOP" : "LMPOP");
+        if (block) {
+            m_argv.push_back(m_timeout);
+        }
+        m_argv.push_back(m_numkeys);
+        m_argv.insert(m_argv.end(), m_options.queues.begin(), m_options.queues.end());
+        m_argv.push_back(m_options.left ? "LEFT" : "RIGHT");
+        m_count = RedisArgument(int64_t(count));
+        m_argv.push_back("COUNT");
+        m_argv.push_back(m_count);
+    } else {
+        m_argv.push_back(m_options.left ? "BLPOP" : "BRPOP");
+        m_argv.insert(m_argv.end(), m_options.queues.begin(), m_options.queues.end());
+        m_argv.push_back(m_timeout);
+    }
+    auto reply = m_client->CommandArgv(m_argv);
+    m_roundTrips.fetch_add(1, std::memory_order_relaxed);
+    if (!reply) {
+        return false;
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        if (m_multiPop && std::string_view(reply->str, reply->len).substr(0, 19) == "ERR unknown command") {
+            m_multiPop = false;
+            return true;
+        }
+        throw std::runtime_error(std::string("redis error, command : ") + m_argv[0].data()
+            + ", error message : " + std::string(reply->str, reply->len));
+    }
+    if (reply->type == REDIS_REPLY_NIL || reply->type != REDIS_REPLY_ARRAY || reply->elements != 2) {
+        /** timeout, or nothing to pop */
+        m_backlog = false;
+        return true;
+    }
+    std::string_view key(reply->element[0]->str, reply->element[0]->len);
+    auto queue = (size_t)(std::find(m_options.queues.begin(), m_options.queues.end(), key) - m_options.queues.begin());
+    std::vector<Item> items;
+    if (m_multiPop) {
+        auto values = reply->element[1];
+        items.reserve(values->elements);
+        for (size_t i = 0; i < values->elements; ++i) {
+            items.push_back({queue, std::string(values->element[i]->str, values->element[i]->len)});
+        }
+    } else {
+        items.push_back({queue, std::string(reply->element[1]->str, reply->element[1]->len)});
+    }
+    m_backlog = m_multiPop && items.size() == count;
+    m_popped.fetch_add(items.size(), std::memory_order_relaxed);
+    {
+        std::lock_guard guard(m_mutex);
+        for (auto& item : items) {
+            m_items.push_back(std::move(item));
+        }
+    }
+    m_itemCond.notify_all();
+    return true;
+}
+void RedisQueueConsumer::Work() {
+    while (true) {
+        Item item;
+        {
+            std::unique_lock lock(m_mutex);
+            m_itemCond.wait(lock, [this]() { return !m_items.empty() || !m_fetching; });
+            if (m_items.empty()) {
+                return;
+            }
+            item = std::move(m_items.front());
+            m_items.pop_front();
+        }
+        m_spaceCond.notify_one();
+        try {
+            m_handler(m_options.queues[item.queue], std::move(item.value));
+            m_handled.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            m_failed.fetch_add(1, std::memory_order_relaxed);
+            RedisReportError(m_options.error_handler, "handler", e);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+/**
+ * @file redis_queue.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-11
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_QUEUE_H____
+#define ____REDIS_QUEUE_H____
+
+#include "redis.h"
+
+struct RedisQueueConsumerOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6379;
+    std::string password;
+    int64_t connect_timeout_ms = 50;
+    /** lists popped from, in priority order */
+    std::vector<std::string> queues;
+    /** LEFT pops the head (queues filled with RPUSH), RIGHT the tail */
+    bool left = true;
+    /** COUNT of one pop, the pop never asks for more than the local queue has room for */
+    size_t batch = 128;
+    /** BLMPOP timeout, also how long Stop waits for the pop in flight */
+    double block_seconds = 1.0;
+    size_t workers = 4;
+    /** bound of the items popped but not yet handled, the pops pause while it is full */
+    size_t capacity = 1024;
+    int64_t reconnect_backoff_min_ms = 10;
+    int64_t reconnect_backoff_max_ms = 1000;
+    /** optional, receives what the stats count as failed, connect_failures or errors, on the thread that hit it */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisQueueConsumerStats {
+    uint64_t round_trips = 0;
+    uint64_t popped = 0;
+    uint64_t handled = 0;
+    /** items whose handler threw */
+    uint64_t failed = 0;
+    uint64_t queued = 0;
+    uint64_t connect_failures = 0;
+    /** pops answered with an error reply (WRONGTYPE, LOADING ...), each one drops the connection */
+    uint64_t errors = 0;
+};
+
+/**
+ * @brief consumer of redis lists with its own connection.
+ *        one thread pops up to batch items per round trip with BLMPOP (LMPOP while the lists have a backlog)
+ *        and hands them to a bounded local queue served by the worker threads. the pop only asks for as
+ *        many items as the queue has room for, so an item is either in redis or on its way to a handler.
+ *        Stop lets the pop in flight return, then the workers finish every item already popped.
+ *        BLMPOP / LMPOP need Redis 7, older servers are served with BLPOP / BRPOP one item at a time.
+ */
+class RedisQueueConsumer final {
+public:
+    using Handler = std::function<void(const std::string& queue, std::string item)>;
+    explicit RedisQueueConsumer(const RedisQueueConsumerOptions& options);
+    RedisQueueConsumer(const RedisQueueConsumer&) = delete;
+    RedisQueueConsumer& operator=(const RedisQueueConsumer&) = delete;
+    ~RedisQueueConsumer();
+
+    /** false when the first connect fails, the consumer keeps retrying */
+    bool Start(Handler handler);
+    /** graceful, returns once every popped item is handled */
+    void Stop();
+    RedisQueueConsumerStats Stats() const;
+private:
+    struct Item {
+        size_t queue;
+        std::string value;
+    };
+    bool Open();
+    void Fetch();
+    /** one round trip, false when the connection is lost, throws on an error reply */
+    bool Pop(size_t count, bool block);
+    void Work();
+private:
+    RedisQueueConsumerOptions m_options;
+    Handler m_handler;
+    RedisClient::Ptr m_client;
+    /** the server knows LMPOP / BLMPOP */
+    bool m_multiPop = true;
+    /** the last pop returned a full batch, more is probably waiting */
+    bool m_backlog = false;
+    std::vector<std::string_view> m_argv;
+    std::string m_numkeys;
+    std::string m_count;
+    std::string m_timeout;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_itemCond;
+    std::condition_variable m_spaceCond;
+    std::deque<Item> m_items;
+    bool m_running = false;
+    bool m_fetching = false;
+    std::thread m_fetcher;
+    std::vector<std::thread> m_workers;
+    std::atomic<uint64_t> m_roundTrips {0};
+    std::atomic<uint64_t> m_popped {0};
+    std::atomic<uint64_t> m_handled {0};
+    std::atomic<uint64_t> m_failed {0};
+    std::atomic<uint64_t> m_connectFailures {0};
+    std::atomic<uint64_t> m_errors {0};
+};
+
+#endif // ! ____REDIS_QUEUE_H____
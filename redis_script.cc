@@ -0,0 +1,43 @@
+#include "redis_script.h"
+
+RedisScript::RedisScript(std::string source)
+    : m_source (std::move(source)) {
+}
+const std::string& RedisScript::Load(RedisClient& client) {
+    /** a failed load throws and leaves the flag unset, the next call tries again */
+    std::call_once(m_loaded, [this, &client]() {
+        auto reply = client.CommandArgv({"SCRIPT", "LOAD", m_source});
+        auto sha = RedisReplyConverter::OptionalString(reply.get(), "SCRIPT LOAD");
+        if (!sha) {
+            throw std::runtime_error("Unexpected reply when executing SCRIPT LOAD");
+        }
+        m_sha = std::move(*sha);
+    });
+    return m_sha;
+}
+RedisReplyView RedisScript::EvalView(RedisClient& client, const std::vector<std::string_view>& keys, const std::vector<std::string_view>& args) {
+    auto reply = Call(client, keys, args);
+    if (!reply) {
+        throw std::runtime_error("redis error, command : EVALSHA, error message : connection lost");
+    }
+    if (reply->type == REDIS_REPLY_ERROR) {
+        throw std::runtime_error("redis error, command : EVALSHA, error message : " + std::string(reply->str, reply->len));
+    }
+    return RedisReplyView(std::move(reply));
+}
+RedisReplyPtr RedisScript::Call(RedisClient& client, const std::vector<std::string_view>& keys, const std::vector<std::string_view>& args) {
+    auto numkeys = RedisArgument(int64_t(keys.size()));
+    std::vector<std::string_view> argv;
+    argv.reserve(3 + keys.size() + args.size());
+    argv.insert(argv.end(), {"EVALSHA", Load(client), numkeys});
+    argv.insert(argv.end(), keys.begin(), keys.end());
+    argv.insert(argv.end(), args.begin(), args.end());
+    auto reply = client.CommandArgv(argv);
+    if (reply && reply->type == REDIS_REPLY_ERROR && std::string_view(reply->str, reply->len).substr(0, 8) == "NOSCRIPT") {
+        /** EVAL runs it and puts it back in the script cache, the sha stays the same */
+        argv[0] = "EVAL";
+        argv[1] = m_source;
+        reply = client.CommandArgv(argv);
+    }
+    return reply;
+}
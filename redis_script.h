@@ -0,0 +1,51 @@
+/**
+ * @file redis_script.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-14
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_SCRIPT_H____
+#define ____REDIS_SCRIPT_H____
+
+#include "redis.h"
+
+/**
+ * @brief lua script run with EVALSHA, so a compound operation costs one round trip and the source is sent once.
+ *        the sha comes from the first SCRIPT LOAD and is shared by every connection and thread using the script.
+ *        a server that lost its script cache (restart, SCRIPT FLUSH, failover) answers NOSCRIPT, the call is then
+ *        repeated as EVAL, which caches the script again. the reply goes through the usual RedisReplyConverter.
+ *        e.g. static RedisScript capped("redis.call('ZINCRBY', KEYS[1], ARGV[1], ARGV[2]) "
+ *                                       "return redis.call('ZREMRANGEBYRANK', KEYS[1], 0, -tonumber(ARGV[3]) - 1)");
+ *             auto removed = capped.Eval(*conn, &RedisReplyConverter::Integer, {"board"}, {"1", "alice", "100"});
+ */
+class RedisScript final {
+public:
+    explicit RedisScript(std::string source);
+    RedisScript(const RedisScript&) = delete;
+    RedisScript& operator=(const RedisScript&) = delete;
+
+    const std::string& Source() const { return m_source; }
+    /** SCRIPT LOAD on the first call, the sha afterwards */
+    const std::string& Load(RedisClient& client);
+
+    template <typename T>
+    T Eval(RedisClient& client, RedisConvertFunc<T> convert
+        , const std::vector<std::string_view>& keys, const std::vector<std::string_view>& args = {}) {
+        auto reply = Call(client, keys, args);
+        return convert(reply.get(), "EVALSHA");
+    }
+    /** the raw reply, for scripts returning nested arrays */
+    RedisReplyView EvalView(RedisClient& client, const std::vector<std::string_view>& keys, const std::vector<std::string_view>& args = {});
+private:
+    RedisReplyPtr Call(RedisClient& client, const std::vector<std::string_view>& keys, const std::vector<std::string_view>& args);
+private:
+    std::string m_source;
+    std::once_flag m_loaded;
+    std::string m_sha;
+};
+
+#endif // ! ____REDIS_SCRIPT_H____
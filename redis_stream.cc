@@ -0,0 +1,313 @@
+#include "redis_stream.h"
+
+RedisStreamConsumer::RedisStreamConsumer(const RedisStreamConsumerOptions& options)
+    : m_options (options) {
+    m_options.batch = std::max<size_t>(m_options.batch, 1);
+    m_options.capacity = std::max<size_t>(m_options.capacity, 1);
+    m_options.workers = std::max<size_t>(m_options.workers, 1);
+    m_options.ack_batch = std::max<size_t>(m_options.ack_batch, 1);
+    m_block = RedisArgument(m_options.block_ms);
+    m_minIdle = RedisArgument(m_options.claim_idle_ms);
+}
+RedisStreamConsumer::~RedisStreamConsumer() {
+    Stop();
+}
+bool RedisStreamConsumer::Start(Handler handler) {
+    Stop();
+    if (m_options.stream.empty() || m_options.group.empty() || m_options.consumer.empty()) {
+        throw std::runtime_error("redis stream consumer without stream, group or consumer");
+    }
+    m_handler = std::move(handler);
+    /** probes the server and creates the group before anything reads */
+    auto connected = Open() != nullptr;
+    {
+        std::lock_guard guard(m_mutex);
+        m_running = true;
+        m_fetching = true;
+    }
+    {
+        std::lock_guard guard(m_ackMutex);
+        m_acking = true;
+    }
+    m_historyId = "0";
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        m_workers.emplace_back(&RedisStreamConsumer::Work, this);
+    }
+    m_fetcher = std::thread(&RedisStreamConsumer::Fetch, this);
+    m_maintainer = std::thread(&RedisStreamConsumer::Maintain, this);
+    return connected;
+}
+void RedisStreamConsumer::Stop() {
+    {
+        std::lock_guard guard(m_mutex);
+        m_running = false;
+    }
+    m_spaceCond.notify_all();
+    /** the read in flight may deliver entries to this consumer, it is waited for, not cut off */
+    if (m_fetcher.joinable()) {
+        m_fetcher.join();
+    }
+    {
+        std::lock_guard guard(m_mutex);
+        m_fetching = false;
+    }
+    m_itemCond.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+    m_workers.clear();
+    {
+        std::lock_guard guard(m_ackMutex);
+        m_acking = false;
+    }
+    m_ackCond.notify_all();
+    if (m_maintainer.joinable()) {
+        m_maintainer.join();
+    }
+}
+RedisStreamConsumerStats RedisStreamConsumer::Stats() const {
+    RedisStreamConsumerStats stats;
+    stats.round_trips = m_roundTrips.load(std::memory_order_relaxed);
+    stats.read = m_read.load(std::memory_order_relaxed);
+    stats.claimed = m_claimed.load(std::memory_order_relaxed);
+    stats.handled = m_handled.load(std::memory_order_relaxed);
+    stats.failed = m_failed.load(std::memory_order_relaxed);
+    stats.acked = m_acked.load(std::memory_order_relaxed);
+    stats.ack_batches = m_ackBatches.load(std::memory_order_relaxed);
+    stats.connect_failures = m_connectFailures.load(std::memory_order_relaxed);
+    stats.errors = m_errors.load(std::memory_order_relaxed);
+    std::lock_guard guard(m_mutex);
+    stats.queued = m_items.size();
+    return stats;
+}
+RedisClient::Ptr RedisStreamConsumer::Open() {
+    auto client = std::make_shared<RedisClient>();
+    try {
+        if (!client->ConnectWithTimeout(m_options.host, m_options.port, m_options.connect_timeout_ms, m_options.password)) {
+            throw std::runtime_error("redis stream consumer connect error:( " + m_options.host + " : " + std::to_string(m_options.port));
+        }
+        if (m_options.create_group) {
+            client->xgroup_create(m_options.stream, m_options.group);
+        }
+    } catch (const std::exception& e) {
+        m_connectFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "connect", e);
+        return nullptr;
+    }
+    return client;
+}
+void RedisStreamConsumer::Fetch() {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    RedisClient::Ptr client;
+    /** entries delivered to this consumer before a restart come first */
+    bool history = true;
+    while (true) {
+        size_t room;
+        {
+            std::unique_lock lock(m_mutex);
+            m_spaceCond.wait(lock, [this]() { return !m_running || m_items.size() < m_options.capacity; });
+            if (!m_running) {
+                return;
+            }
+            room = m_options.capacity - m_items.size();
+        }
+        if (!client) {
+            client = Open();
+            if (!client) {
+                std::unique_lock lock(m_mutex);
+                m_spaceCond.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return !m_running; });
+                backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+                continue;
+            }
+            backoff = m_options.reconnect_backoff_min_ms;
+        }
+        try {
+            auto entries = Read(*client, std::min(room, m_options.batch), history);
+            if (history) {
+                if (entries.empty()) {
+                    history = false;
+                } else {
+                    m_historyId = entries.back().id;
+                }
+            }
+            m_read.fetch_add(entries.size(), std::memory_order_relaxed);
+            Push(entries);
+        } catch (const std::exception& e) {
+            m_errors.fetch_add(1, std::memory_order_relaxed);
+            RedisReportError(m_options.error_handler, "read", e);
+            client.reset();
+        }
+    }
+}
+std::vector<RedisStreamEntry> RedisStreamConsumer::Read(RedisClient& client, size_t count, bool history) {
+    m_count = RedisArgument(int64_t(count));
+    std::vector<std::string_view> argv {"XREADGROUP", "GROUP", m_options.group, m_options.consumer, "COUNT", m_count};
+    if (!history) {
+        argv.insert(argv.end(), {"BLOCK", m_block});
+    }
+    argv.insert(argv.end(), {"STREAMS", m_options.stream, history ? std::string_view(m_historyId) : std::string_view(">")});
+    auto reply = client.CommandView(argv);
+    m_roundTrips.fetch_add(1, std::memory_order_relaxed);
+    /** nil on timeout, otherwise [[stream, entries]] */
+    if (reply.IsNil() || reply.empty()) {
+        return {};
+    }
+    auto streams = reply.Get();
+    if (streams->element[0]->type != REDIS_REPLY_ARRAY || streams->element[0]->elements != 2) {
+        throw std::runtime_error("Unexpected reply when executing XREADGROUP for key: " + m_options.stream);
+    }
+    return RedisReplyConverter::StreamEntries(streams->element[0]->element[1], "XREADGROUP");
+}
+void RedisStreamConsumer::Push(std::vector<RedisStreamEntry>& entries) {
+    if (entries.empty()) {
+        return;
+    }
+    std::vector<std::string> deleted;
+    {
+        std::lock_guard guard(m_mutex);
+        for (auto& entry : entries) {
+            if (entry.fields.empty()) {
+                deleted.push_back(std::move(entry.id));
+            } else {
+                m_items.push_back(std::move(entry));
+            }
+        }
+    }
+    m_itemCond.notify_all();
+    if (!deleted.empty()) {
+        /** deleted while pending, nothing to handle but it leaves the pending list only by an ack */
+        std::lock_guard guard(m_ackMutex);
+        m_acks.insert(m_acks.end(), std::make_move_iterator(deleted.begin()), std::make_move_iterator(deleted.end()));
+    }
+}
+void RedisStreamConsumer::Work() {
+    while (true) {
+        RedisStreamEntry entry;
+        {
+            std::unique_lock lock(m_mutex);
+            m_itemCond.wait(lock, [this]() { return !m_items.empty() || !m_fetching; });
+            if (m_items.empty()) {
+                return;
+            }
+            entry = std::move(m_items.front());
+            m_items.pop_front();
+        }
+        m_spaceCond.notify_one();
+        try {
+            m_handler(entry);
+        } catch (const std::exception& e) {
+            m_failed.fetch_add(1, std::memory_order_relaxed);
+            RedisReportError(m_options.error_handler, "handler", std::runtime_error(std::string(e.what()) + ", id : " + entry.id));
+            continue;
+        }
+        m_handled.fetch_add(1, std::memory_order_relaxed);
+        bool full;
+        {
+            std::lock_guard guard(m_ackMutex);
+            m_acks.push_back(std::move(entry.id));
+            full = m_acks.size() >= m_options.ack_batch;
+        }
+        if (full) {
+            m_ackCond.notify_one();
+        }
+    }
+}
+void RedisStreamConsumer::Maintain() {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    RedisClient::Ptr client;
+    auto nextClaim = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_options.claim_interval_ms);
+    while (true) {
+        bool acking;
+        {
+            std::unique_lock lock(m_ackMutex);
+            m_ackCond.wait_for(lock, std::chrono::milliseconds(client ? m_options.ack_interval_ms : backoff), [this]() {
+                return m_acks.size() >= m_options.ack_batch || !m_acking;
+            });
+            acking = m_acking;
+        }
+        if (!client) {
+            client = Open();
+            if (!client) {
+                backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+                if (!acking) {
+                    /** the ids left are delivered again once claimed */
+                    return;
+                }
+                continue;
+            }
+            backoff = m_options.reconnect_backoff_min_ms;
+        }
+        if (!Acknowledge(*client)) {
+            client.reset();
+            backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+            if (!acking) {
+                return;
+            }
+            continue;
+        }
+        if (!acking) {
+            return;
+        }
+        if (m_options.claim_idle_ms > 0 && std::chrono::steady_clock::now() >= nextClaim) {
+            nextClaim = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_options.claim_interval_ms);
+            try {
+                Claim(*client);
+            } catch (const std::exception& e) {
+                m_errors.fetch_add(1, std::memory_order_relaxed);
+                RedisReportError(m_options.error_handler, "claim", e);
+                client.reset();
+            }
+        }
+    }
+}
+bool RedisStreamConsumer::Acknowledge(RedisClient& client) {
+    std::vector<std::string> ids;
+    {
+        std::lock_guard guard(m_ackMutex);
+        ids.swap(m_acks);
+    }
+    if (ids.empty()) {
+        return true;
+    }
+    try {
+        auto acked = client.xack(m_options.stream, m_options.group, ids);
+        m_roundTrips.fetch_add(1, std::memory_order_relaxed);
+        m_acked.fetch_add(acked, std::memory_order_relaxed);
+        ++m_ackBatches;
+        return true;
+    } catch (const std::exception& e) {
+        m_errors.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "ack", e);
+    }
+    std::lock_guard guard(m_ackMutex);
+    m_acks.insert(m_acks.end(), std::make_move_iterator(ids.begin()), std::make_move_iterator(ids.end()));
+    return false;
+}
+void RedisStreamConsumer::Claim(RedisClient& client) {
+    /** one sweep of the pending list per interval, bounded by the room in the local queue */
+    while (true) {
+        size_t room;
+        {
+            std::lock_guard guard(m_mutex);
+            if (!m_running || m_items.size() >= m_options.capacity) {
+                return;
+            }
+            room = std::min(m_options.capacity - m_items.size(), m_options.batch);
+        }
+        auto count = RedisArgument(int64_t(room));
+        auto reply = client.CommandView({"XAUTOCLAIM", m_options.stream, m_options.group, m_options.consumer
+            , m_minIdle, m_claimCursor, "COUNT", count});
+        m_roundTrips.fetch_add(1, std::memory_order_relaxed);
+        /** [next cursor, entries, deleted ids (Redis 7)] */
+        if (reply.size() < 2) {
+            throw std::runtime_error("Unexpected reply when executing XAUTOCLAIM for key: " + m_options.stream);
+        }
+        m_claimCursor = std::string(reply[0]);
+        auto entries = RedisReplyConverter::StreamEntries(reply.Get()->element[1], "XAUTOCLAIM");
+        m_claimed.fetch_add(entries.size(), std::memory_order_relaxed);
+        Push(entries);
+        if (m_claimCursor == "0-0" || entries.empty()) {
+            return;
+        }
+    }
+}
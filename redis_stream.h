@@ -0,0 +1,145 @@
+/**
+ * @file redis_stream.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-13
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_STREAM_H____
+#define ____REDIS_STREAM_H____
+
+#include "redis.h"
+
+struct RedisStreamConsumerOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6379;
+    std::string password;
+    int64_t connect_timeout_ms = 50;
+    std::string stream;
+    std::string group;
+    /** unique per process, entries delivered to it stay its own until acked or claimed */
+    std::string consumer;
+    /** XGROUP CREATE <stream> <group> $ MKSTREAM on connect, an existing group is kept */
+    bool create_group = true;
+    /** COUNT of one read, never more than the local queue has room for */
+    size_t batch = 128;
+    /** BLOCK of one read, also how long Stop waits for the read in flight */
+    int64_t block_ms = 1000;
+    size_t workers = 4;
+    /** entries read but not yet handled, reading pauses while it is full */
+    size_t capacity = 1024;
+    /** handled ids are acked in one XACK once this many are waiting ... */
+    size_t ack_batch = 256;
+    /** ... or once the oldest waited this long */
+    int64_t ack_interval_ms = 50;
+    /** entries pending this long on any consumer are taken over with XAUTOCLAIM, 0 never claims.
+     *  must exceed the longest time an entry spends queued and handled, or it is handled twice */
+    int64_t claim_idle_ms = 60000;
+    int64_t claim_interval_ms = 5000;
+    int64_t reconnect_backoff_min_ms = 10;
+    int64_t reconnect_backoff_max_ms = 1000;
+    /** optional, receives what the stats count as failed, connect_failures or errors, on the thread that hit it */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisStreamConsumerStats {
+    uint64_t round_trips = 0;
+    uint64_t read = 0;
+    uint64_t claimed = 0;
+    uint64_t handled = 0;
+    /** entries whose handler threw, they stay pending until claimed again */
+    uint64_t failed = 0;
+    uint64_t acked = 0;
+    uint64_t ack_batches = 0;
+    uint64_t queued = 0;
+    uint64_t connect_failures = 0;
+    /** reads, claims and acks that threw, each one drops its connection */
+    uint64_t errors = 0;
+};
+
+/**
+ * @brief at-least-once consumer of one stream in a consumer group.
+ *        a reader connection fetches with XREADGROUP COUNT n BLOCK ms, starting with the entries this consumer
+ *        got but never acked before a restart, and queues them for the worker threads. the ids of handled entries
+ *        are collected and acked in batches by a second connection, which also takes over entries left pending
+ *        by dead consumers with XAUTOCLAIM (Redis 6.2). entries are handled in parallel, not in stream order.
+ *        Stop lets the read in flight return, handles everything queued and acks it.
+ *        e.g. consumer.Start<Job>([](const std::string& id, Job& job) { ... });
+ */
+class RedisStreamConsumer final {
+public:
+    using Handler = std::function<void(const RedisStreamEntry& entry)>;
+    explicit RedisStreamConsumer(const RedisStreamConsumerOptions& options);
+    RedisStreamConsumer(const RedisStreamConsumer&) = delete;
+    RedisStreamConsumer& operator=(const RedisStreamConsumer&) = delete;
+    ~RedisStreamConsumer();
+
+    /** false when the first connect fails, the consumer keeps retrying */
+    bool Start(Handler handler);
+    /** entries decoded into an object listed by RAPIDJSON_REFLECTION_PARSE, one that does not parse counts as failed */
+    template <typename T>
+    bool Start(std::function<void(const std::string& id, T& object)> handler) {
+        return Start([handler = std::move(handler)](const RedisStreamEntry& entry) {
+            T object {};
+            if (!entry.Decode(object)) {
+                throw std::runtime_error("redis stream entry does not decode, id : " + entry.id);
+            }
+            handler(entry.id, object);
+        });
+    }
+    /** graceful, returns once every entry read is handled and acked */
+    void Stop();
+    RedisStreamConsumerStats Stats() const;
+private:
+    RedisClient::Ptr Open();
+    void Fetch();
+    /** XREADGROUP, history reads the entries already delivered to this consumer */
+    std::vector<RedisStreamEntry> Read(RedisClient& client, size_t count, bool history);
+    /** queues entries for the workers, a deleted one is only acked */
+    void Push(std::vector<RedisStreamEntry>& entries);
+    void Work();
+    void Maintain();
+    /** false when the connection failed, the ids are kept for the next try */
+    bool Acknowledge(RedisClient& client);
+    void Claim(RedisClient& client);
+private:
+    RedisStreamConsumerOptions m_options;
+    Handler m_handler;
+    std::string m_count;
+    std::string m_block;
+    std::string m_minIdle;
+    /** where the history read goes on, entries stay pending so "0" would return the same ones again */
+    std::string m_historyId = "0";
+    /** XAUTOCLAIM cursor */
+    std::string m_claimCursor = "0-0";
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_itemCond;
+    std::condition_variable m_spaceCond;
+    std::deque<RedisStreamEntry> m_items;
+    bool m_running = false;
+    bool m_fetching = false;
+
+    std::mutex m_ackMutex;
+    std::condition_variable m_ackCond;
+    std::vector<std::string> m_acks;
+    bool m_acking = false;
+
+    std::thread m_fetcher;
+    std::thread m_maintainer;
+    std::vector<std::thread> m_workers;
+    std::atomic<uint64_t> m_roundTrips {0};
+    std::atomic<uint64_t> m_read {0};
+    std::atomic<uint64_t> m_claimed {0};
+    std::atomic<uint64_t> m_handled {0};
+    std::atomic<uint64_t> m_failed {0};
+    std::atomic<uint64_t> m_acked {0};
+    std::atomic<uint64_t> m_ackBatches {0};
+    std::atomic<uint64_t> m_connectFailures {0};
+    std::atomic<uint64_t> m_errors {0};
+};
+
+#endif // ! ____REDIS_STREAM_H____
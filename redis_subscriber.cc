@@ -0,0 +1,293 @@
+#include "redis_subscriber.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+
+RedisSubscriber::RedisSubscriber(const RedisSubscriberOptions& options)
+    : m_options (options) {
+    m_options.workers = std::max<size_t>(m_options.workers, 1);
+    m_options.capacity = std::max<size_t>(m_options.capacity, 1);
+    m_options.max_batch = std::max<size_t>(m_options.max_batch, 1);
+    m_workers = std::make_unique<Worker[]>(m_options.workers);
+}
+RedisSubscriber::~RedisSubscriber() {
+    Stop();
+}
+bool RedisSubscriber::Start() {
+    Stop();
+    m_running = true;
+    m_draining = false;
+    auto connected = Open();
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        m_workers[i].thread = std::thread(&RedisSubscriber::Work, this, std::ref(m_workers[i]));
+    }
+    m_reader = std::thread(&RedisSubscriber::Read, this);
+    return connected;
+}
+void RedisSubscriber::Stop() {
+    {
+        std::lock_guard guard(m_stateMutex);
+        m_running = false;
+        /** wakes the reader out of its blocking read */
+        if (m_connection && m_connection->m_context) {
+            ::shutdown(m_connection->m_context->fd, SHUT_RDWR);
+        }
+    }
+    m_stopCond.notify_all();
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        std::lock_guard guard(m_workers[i].mutex);
+        m_workers[i].spaceCond.notify_all();
+    }
+    if (m_reader.joinable()) {
+        m_reader.join();
+    }
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        auto& worker = m_workers[i];
+        {
+            std::lock_guard guard(worker.mutex);
+            m_draining = true;
+        }
+        worker.itemCond.notify_all();
+        if (worker.thread.joinable()) {
+            worker.thread.join();
+        }
+    }
+    std::lock_guard guard(m_stateMutex);
+    m_connection.reset();
+}
+RedisSubscriberStats RedisSubscriber::Stats() const {
+    RedisSubscriberStats stats;
+    stats.received = m_received.load(std::memory_order_relaxed);
+    stats.delivered = m_delivered.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    stats.batches = m_batches.load(std::memory_order_relaxed);
+    stats.reconnects = m_reconnects.load(std::memory_order_relaxed);
+    stats.connect_failures = m_connectFailures.load(std::memory_order_relaxed);
+    stats.failed_batches = m_failedBatches.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < m_options.workers; ++i) {
+        std::lock_guard guard(m_workers[i].mutex);
+        stats.queued += m_workers[i].entries.size();
+    }
+    return stats;
+}
+void RedisSubscriber::Subscribe(const std::string& channel, Handler handler) {
+    std::lock_guard guard(m_stateMutex);
+    m_channels[channel] = std::make_shared<const Handler>(std::move(handler));
+    Send({"SUBSCRIBE", channel});
+}
+void RedisSubscriber::PSubscribe(const std::string& pattern, Handler handler) {
+    std::lock_guard guard(m_stateMutex);
+    m_patterns[pattern] = std::make_shared<const Handler>(std::move(handler));
+    Send({"PSUBSCRIBE", pattern});
+}
+void RedisSubscriber::Unsubscribe(const std::string& channel) {
+    std::lock_guard guard(m_stateMutex);
+    if (m_channels.erase(channel)) {
+        Send({"UNSUBSCRIBE", channel});
+    }
+}
+void RedisSubscriber::PUnsubscribe(const std::string& pattern) {
+    std::lock_guard guard(m_stateMutex);
+    if (m_patterns.erase(pattern)) {
+        Send({"PUNSUBSCRIBE", pattern});
+    }
+}
+void RedisSubscriber::Send(const std::vector<std::string_view>& argv) {
+    if (!m_connection || m_connection->IsBroken()) {
+        /** replayed by the next connect */
+        return;
+    }
+    /** the reader only ever reads this socket, so a command can go out while it blocks */
+    m_command.clear();
+    RedisAppendCommand(m_command, argv.data(), argv.size());
+    auto fd = m_connection->m_context->fd;
+    size_t written = 0;
+    while (written < m_command.size()) {
+        auto n = ::send(fd, m_command.data() + written, m_command.size() - written, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            /** the reader sees the broken socket too and reconnects, which replays every subscription */
+            ::shutdown(fd, SHUT_RDWR);
+            return;
+        }
+        written += n;
+    }
+}
+bool RedisSubscriber::Open() {
+    auto connection = std::make_shared<RedisClient>();
+    try {
+        if (!connection->ConnectWithTimeout(m_options.host, m_options.port, m_options.connect_timeout_ms, m_options.password)) {
+            throw std::runtime_error("redis subscriber connect error:( " + m_options.host + " : " + std::to_string(m_options.port));
+        }
+    } catch (const std::exception& e) {
+        m_connectFailures.fetch_add(1, std::memory_order_relaxed);
+        RedisReportError(m_options.error_handler, "connect", e);
+        return false;
+    }
+    std::lock_guard guard(m_stateMutex);
+    /** checked under the lock Stop takes, so Stop either sees this connection or we see Stop */
+    if (!m_running) {
+        return false;
+    }
+    m_connection = connection;
+    std::vector<std::string_view> argv;
+    for (auto [command, subscriptions] : {std::pair {"SUBSCRIBE", &m_channels}, std::pair {"PSUBSCRIBE", &m_patterns}}) {
+        if (subscriptions->empty()) {
+            continue;
+        }
+        argv.assign(1, command);
+        for (auto& [name, handler] : *subscriptions) {
+            argv.push_back(name);
+        }
+        Send(argv);
+    }
+    return true;
+}
+void RedisSubscriber::Read() {
+    auto backoff = m_options.reconnect_backoff_min_ms;
+    std::vector<Entry> entries;
+    std::vector<std::pair<bool, std::string>> keys;
+    while (m_running) {
+        RedisClient::Ptr connection;
+        {
+            std::lock_guard guard(m_stateMutex);
+            connection = m_connection;
+        }
+        if (!connection) {
+            std::unique_lock lock(m_stateMutex);
+            m_stopCond.wait_for(lock, std::chrono::milliseconds(backoff), [this]() { return !m_running; });
+            lock.unlock();
+            backoff = std::min(backoff * 2, m_options.reconnect_backoff_max_ms);
+            if (m_running && Open()) {
+                ++m_reconnects;
+            }
+            continue;
+        }
+        backoff = m_options.reconnect_backoff_min_ms;
+
+        auto context = connection->m_context.get();
+        redisReply* r = nullptr;
+        while (redisGetReply(context, (void**)&r) == REDIS_OK) {
+            /** the first reply blocks, the rest of what that read brought in is parsed without another read */
+            do {
+                auto reply = connection->WrapReply(r);
+                if (!reply || reply->type != REDIS_REPLY_ARRAY || reply->elements < 3
+                    || reply->element[0]->type != REDIS_REPLY_STRING) {
+                    continue;
+                }
+                auto kind = reply->element[0]->str;
+                auto element = [&reply](size_t i) { return std::string(reply->element[i]->str, reply->element[i]->len); };
+                if (!strcmp(kind, "message") && reply->elements == 3) {
+                    entries.push_back({nullptr, {element(1), std::string(), element(2)}});
+                    keys.emplace_back(false, entries.back().message.channel);
+                } else if (!strcmp(kind, "pmessage") && reply->elements == 4) {
+                    entries.push_back({nullptr, {element(2), element(1), element(3)}});
+                    keys.emplace_back(true, entries.back().message.pattern);
+                }
+            } while (context->reader && redisReaderGetReply(context->reader, (void**)&r) == REDIS_OK && r);
+            if (entries.empty()) {
+                continue;
+            }
+            m_received.fetch_add(entries.size(), std::memory_order_relaxed);
+            {
+                /** one lookup pass per read, a message of an unsubscribed channel has nobody to go to */
+                std::lock_guard guard(m_stateMutex);
+                for (size_t i = 0; i < entries.size(); ++i) {
+                    auto& subscriptions = keys[i].first ? m_patterns : m_channels;
+                    if (auto it = subscriptions.find(keys[i].second); it != subscriptions.end()) {
+                        entries[i].handler = it->second;
+                    }
+                }
+            }
+            Dispatch(entries);
+            entries.clear();
+            keys.clear();
+        }
+        std::lock_guard guard(m_stateMutex);
+        if (m_connection == connection) {
+            m_connection.reset();
+        }
+    }
+}
+void RedisSubscriber::Dispatch(std::vector<Entry>& entries) {
+    std::vector<size_t> targets(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        targets[i] = std::hash<std::string>()(entries[i].message.channel) % m_options.workers;
+    }
+    for (size_t w = 0; w < m_options.workers; ++w) {
+        auto& worker = m_workers[w];
+        bool queued = false;
+        std::unique_lock lock(worker.mutex);
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (targets[i] != w || !entries[i].handler) {
+                continue;
+            }
+            if (worker.entries.size() >= m_options.capacity) {
+                if (m_options.overflow == RedisOverflowPolicy::DropNewest) {
+                    ++m_dropped;
+                    continue;
+                }
+                if (m_options.overflow == RedisOverflowPolicy::DropOldest) {
+                    worker.entries.pop_front();
+                    ++m_dropped;
+                } else {
+                    if (queued) {
+                        worker.itemCond.notify_one();
+                    }
+                    worker.spaceCond.wait(lock, [this, &worker]() {
+                        return worker.entries.size() < m_options.capacity || !m_running;
+                    });
+                }
+            }
+            worker.entries.push_back(std::move(entries[i]));
+            queued = true;
+        }
+        lock.unlock();
+        if (queued) {
+            worker.itemCond.notify_one();
+        }
+    }
+}
+void RedisSubscriber::Work(Worker& worker) {
+    std::vector<Entry> batch;
+    std::vector<std::pair<HandlerPtr, std::vector<RedisMessage>>> runs;
+    while (true) {
+        {
+            std::unique_lock lock(worker.mutex);
+            worker.itemCond.wait(lock, [this, &worker]() { return !worker.entries.empty() || m_draining; });
+            if (worker.entries.empty()) {
+                return;
+            }
+            auto count = std::min(worker.entries.size(), m_options.max_batch);
+            for (size_t i = 0; i < count; ++i) {
+                batch.push_back(std::move(worker.entries.front()));
+                worker.entries.pop_front();
+            }
+        }
+        worker.spaceCond.notify_one();
+        /** one call per handler, in the order the messages arrived */
+        for (auto& entry : batch) {
+            auto it = std::find_if(runs.begin(), runs.end(), [&entry](auto& run) { return run.first == entry.handler; });
+            if (it == runs.end()) {
+                it = runs.insert(runs.end(), {entry.handler, {}});
+            }
+            it->second.push_back(std::move(entry.message));
+        }
+        for (auto& [handler, messages] : runs) {
+            try {
+                (*handler)(messages);
+            } catch (const std::exception& e) {
+                m_failedBatches.fetch_add(1, std::memory_order_relaxed);
+                RedisReportError(m_options.error_handler, "handler", e);
+            }
+            m_delivered.fetch_add(messages.size(), std::memory_order_relaxed);
+            ++m_batches;
+        }
+        batch.clear();
+        runs.clear();
+    }
+}
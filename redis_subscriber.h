@@ -0,0 +1,134 @@
+/**
+ * @file redis_subscriber.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2024-06-12
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____REDIS_SUBSCRIBER_H____
+#define ____REDIS_SUBSCRIBER_H____
+
+#include "redis.h"
+
+/** what the reader does with a message whose worker queue is full */
+enum class RedisOverflowPolicy {
+    /** the reader waits, the server buffers meanwhile (client-output-buffer-limit pubsub applies) */
+    Block,
+    DropNewest,
+    DropOldest,
+};
+
+struct RedisSubscriberOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 6379;
+    std::string password;
+    int64_t connect_timeout_ms = 50;
+    /** messages of one channel always go to the same worker, so they are delivered in order */
+    size_t workers = 2;
+    /** queued messages per worker */
+    size_t capacity = 4096;
+    /** most messages one handler call gets */
+    size_t max_batch = 256;
+    RedisOverflowPolicy overflow = RedisOverflowPolicy::Block;
+    int64_t reconnect_backoff_min_ms = 10;
+    int64_t reconnect_backoff_max_ms = 1000;
+    /** optional, receives what the stats count as connect_failures or failed_batches, on the thread that hit it */
+    RedisErrorHandler error_handler;
+};
+
+struct RedisSubscriberStats {
+    uint64_t received = 0;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    /** handler calls */
+    uint64_t batches = 0;
+    uint64_t reconnects = 0;
+    uint64_t queued = 0;
+    uint64_t connect_failures = 0;
+    /** handler calls that threw, their messages still count as delivered */
+    uint64_t failed_batches = 0;
+};
+
+struct RedisMessage {
+    std::string channel;
+    /** the pattern that matched, empty for SUBSCRIBE */
+    std::string pattern;
+    std::string payload;
+};
+
+/**
+ * @brief SUBSCRIBE / PSUBSCRIBE on one connection of its own.
+ *        a reader thread takes every message the connection has buffered in one go, queues it for the worker
+ *        its channel hashes to, and the workers hand each handler the messages of a run as one batch.
+ *        subscriptions can change at any time, they are written straight to the socket the reader blocks on
+ *        and replayed after a reconnect. messages published while disconnected are lost, as with any pub/sub.
+ *        e.g. subscriber.Subscribe("invalidate", [](const std::vector<RedisMessage>& batch) { ... });
+ */
+class RedisSubscriber final {
+public:
+    using Handler = std::function<void(const std::vector<RedisMessage>& messages)>;
+    explicit RedisSubscriber(const RedisSubscriberOptions& options = RedisSubscriberOptions());
+    RedisSubscriber(const RedisSubscriber&) = delete;
+    RedisSubscriber& operator=(const RedisSubscriber&) = delete;
+    ~RedisSubscriber();
+
+    /** false when the first connect fails, the subscriber keeps retrying */
+    bool Start();
+    /** messages already queued are still delivered */
+    void Stop();
+    RedisSubscriberStats Stats() const;
+
+    /** a later call for the same channel or pattern replaces the handler */
+    void Subscribe(const std::string& channel, Handler handler);
+    void PSubscribe(const std::string& pattern, Handler handler);
+    /** messages already queued for it are still delivered */
+    void Unsubscribe(const std::string& channel);
+    void PUnsubscribe(const std::string& pattern);
+private:
+    using HandlerPtr = std::shared_ptr<const Handler>;
+    struct Entry {
+        HandlerPtr handler;
+        RedisMessage message;
+    };
+    struct Worker {
+        std::mutex mutex;
+        std::condition_variable itemCond;
+        std::condition_variable spaceCond;
+        std::deque<Entry> entries;
+        std::thread thread;
+    };
+    /** writes one command on the subscribed connection, m_stateMutex held */
+    void Send(const std::vector<std::string_view>& argv);
+    bool Open();
+    void Read();
+    /** queues what one read produced, grouped per worker */
+    void Dispatch(std::vector<Entry>& entries);
+    void Work(Worker& worker);
+private:
+    RedisSubscriberOptions m_options;
+    std::unique_ptr<Worker[]> m_workers;
+    std::atomic<bool> m_running {false};
+    /** set once the reader is gone, workers return when their queue is empty */
+    std::atomic<bool> m_draining {false};
+
+    mutable std::mutex m_stateMutex;
+    std::condition_variable m_stopCond;
+    std::unordered_map<std::string, HandlerPtr> m_channels;
+    std::unordered_map<std::string, HandlerPtr> m_patterns;
+    RedisClient::Ptr m_connection;
+    std::string m_command;
+    std::thread m_reader;
+
+    std::atomic<uint64_t> m_received {0};
+    std::atomic<uint64_t> m_delivered {0};
+    std::atomic<uint64_t> m_dropped {0};
+    std::atomic<uint64_t> m_batches {0};
+    std::atomic<uint64_t> m_reconnects {0};
+    std::atomic<uint64_t> m_connectFailures {0};
+    std::atomic<uint64_t> m_failedBatches {0};
+};
+
+#endif // ! ____REDIS_SUBSCRIBER_H____
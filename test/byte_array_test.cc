@@ -0,0 +1,182 @@
+/**
+ * @file byte_array_test.cc
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief round trip, schema evolution and corrupt input of byte_array.h
+ *        g++ -std=c++17 -I.. byte_array_test.cc
+ *        ./a.out, exits non-zero and names every failed check on stderr
+ * @version 0.1
+ * @date 2024-06-09
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "byte_array.h"
+#include "check.h"
+
+namespace {
+
+enum class Color : int32_t { red = 1, blue = -3 };
+
+struct Inner {
+    std::string name;
+    int32_t score = 0;
+};
+BYTE_ARRAY_REFLECTION(Inner, name, score)
+
+struct Everything {
+    std::string text;
+    int32_t small = 0;
+    int64_t big = 0;
+    uint64_t unsigned_big = 0;
+    bool flag = false;
+    double real = 0;
+    float single = 0;
+    std::optional<std::string> present;
+    std::optional<std::string> absent;
+    std::vector<int32_t> numbers;
+    std::map<std::string, int32_t> table;
+    std::array<uint8_t, 3> fixed {};
+    Color color = Color::red;
+    Inner inner;
+    std::vector<Inner> inners;
+};
+BYTE_ARRAY_REFLECTION(Everything, text, small, big, unsigned_big, flag, real, single, present, absent, numbers, table, fixed, color, inner, inners)
+
+/** the same struct before and after a member was appended */
+struct Before {
+    int32_t id = 0;
+    std::string name;
+};
+BYTE_ARRAY_REFLECTION(Before, id, name)
+
+struct After {
+    int32_t id = 0;
+    std::string name;
+    std::vector<std::string> tags {"default"};
+};
+BYTE_ARRAY_REFLECTION(After, id, name, tags)
+
+struct Versioned {
+    int32_t id = 0;
+};
+BYTE_ARRAY_REFLECTION(Versioned, id)
+BYTE_ARRAY_SCHEMA_VERSION(Versioned, 2)
+
+Everything MakeEverything() {
+    Everything value;
+    value.text = std::string("he\0llo", 6);
+    value.small = -5;
+    value.big = std::numeric_limits<int64_t>::min();
+    value.unsigned_big = std::numeric_limits<uint64_t>::max();
+    value.flag = true;
+    value.real = 3.5;
+    value.single = -0.25f;
+    value.present = "x";
+    value.numbers = {1, -2, 300000};
+    value.table = {{"a", 1}, {"b", -1}};
+    value.fixed = {1, 2, 255};
+    value.color = Color::blue;
+    value.inner = {"in", 7};
+    value.inners = {{"one", 1}, {"two", -2}};
+    return value;
+}
+
+template <typename type>
+bool Throws(std::string_view data) {
+    type value;
+    try {
+        ByteArrayConverter::deserialise(data, value);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void TestRoundTrip() {
+    auto value = MakeEverything();
+    std::string buffer;
+    ByteArrayConverter::serialise(value, buffer);
+    Everything read;
+    ByteArrayConverter::deserialise(buffer, read);
+    CHECK(read.text == value.text);
+    CHECK(read.small == value.small);
+    CHECK(read.big == value.big);
+    CHECK(read.unsigned_big == value.unsigned_big);
+    CHECK(read.flag == value.flag);
+    CHECK(read.real == value.real);
+    CHECK(read.single == value.single);
+    CHECK(read.present == value.present);
+    CHECK(!read.absent);
+    CHECK(read.numbers == value.numbers);
+    CHECK(read.table == value.table);
+    CHECK(read.fixed == value.fixed);
+    CHECK(read.color == value.color);
+    CHECK(read.inner.name == "in" && read.inner.score == 7);
+    CHECK(read.inners.size() == 2 && read.inners[1].name == "two" && read.inners[1].score == -2);
+
+    /** zigzag keeps small negative numbers in one byte: version, size, value */
+    Versioned small;
+    small.id = -1;
+    buffer.clear();
+    ByteArrayConverter::serialise(small, buffer);
+    CHECK(buffer.size() == 3);
+}
+
+void TestTruncated() {
+    std::string buffer;
+    ByteArrayConverter::serialise(MakeEverything(), buffer);
+    size_t accepted = 0;
+    for (size_t size = 0; size < buffer.size(); ++size) {
+        if (!Throws<Everything>(std::string_view(buffer.data(), size))) {
+            ++accepted;
+        }
+    }
+    CHECK(accepted == 0);
+}
+
+void TestCorrupt() {
+    /** a varint that never ends */
+    CHECK(Throws<Everything>(std::string(11, '\xff')));
+    /** a string longer than the buffer */
+    std::string buffer;
+    ByteArrayConverter::serialise(Before {1, "abc"}, buffer);
+    auto corrupt = buffer;
+    corrupt[3] = '\x7f';
+    CHECK(Throws<Before>(corrupt));
+}
+
+void TestSchemaEvolution() {
+    std::string buffer;
+    ByteArrayConverter::serialise(Before {7, "old"}, buffer);
+    After newer;
+    ByteArrayConverter::deserialise(buffer, newer);
+    CHECK(newer.id == 7 && newer.name == "old");
+    CHECK(newer.tags == std::vector<std::string> {"default"});
+
+    buffer.clear();
+    ByteArrayConverter::serialise(After {8, "new", {"a", "b"}}, buffer);
+    Before older;
+    ByteArrayConverter::deserialise(buffer, older);
+    CHECK(older.id == 8 && older.name == "new");
+
+    /** another schema version is refused, not misread */
+    buffer.clear();
+    ByteArrayConverter::serialise(Versioned {9}, buffer);
+    CHECK(Throws<Before>(buffer));
+}
+
+} // namespace
+
+int main() {
+    TestRoundTrip();
+    TestTruncated();
+    TestCorrupt();
+    TestSchemaEvolution();
+    return CheckResult();
+}
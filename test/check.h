@@ -0,0 +1,36 @@
+/**
+ * @file check.h
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief the checks shared by the tests, a failed CHECK names itself on stderr and the test goes on,
+ *        main ends with return CheckResult();
+ * @version 0.1
+ * @date 2024-06-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef ____CHECK_H____
+#define ____CHECK_H____
+
+#include <cstdio>
+
+inline int g_checkFailures = 0;
+
+#define CHECK(expr) do { \
+    if (!(expr)) { \
+        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+        ++g_checkFailures; \
+    } \
+} while (0)
+
+/** prints the outcome, the exit code of the test */
+inline int CheckResult() {
+    if (g_checkFailures) {
+        std::fprintf(stderr, "%d checks failed\n", g_checkFailures);
+        return 1;
+    }
+    std::printf("ok\n");
+    return 0;
+}
+
+#endif // ! ____CHECK_H____
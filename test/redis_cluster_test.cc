@@ -0,0 +1,102 @@
+/**
+ * @file redis_cluster_test.cc
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief slot hashing, multi-key splitting and redirect parsing of RedisClusterClient, no server needed
+ *        g++ -std=c++20 -I.. redis_cluster_test.cc ../redis_cluster.cc ../redis.cc ../redis_arena.cc ../redis_metrics.cc -lhiredis -lpthread
+ *        ./a.out, exits non-zero and names every failed check on stderr
+ * @version 0.1
+ * @date 2024-06-25
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <string>
+#include <vector>
+
+#include "redis_cluster.h"
+#include "check.h"
+
+namespace {
+
+void TestSlot() {
+    /** CRC16/XMODEM of "123456789" is 0x31C3, below 16384 so it is the slot itself */
+    CHECK(RedisClusterClient::Slot("123456789") == 0x31C3);
+    CHECK(RedisClusterClient::Slot("foo") == 12182);
+    CHECK(RedisClusterClient::Slot("") == 0);
+    /** only the first {...} with something inside counts */
+    CHECK(RedisClusterClient::Slot("{user1000}.following") == RedisClusterClient::Slot("user1000"));
+    CHECK(RedisClusterClient::Slot("{user1000}.following") == RedisClusterClient::Slot("{user1000}.followers"));
+    CHECK(RedisClusterClient::Slot("foo{bar}{zap}") == RedisClusterClient::Slot("bar"));
+    CHECK(RedisClusterClient::Slot("foo{{bar}}zap") == RedisClusterClient::Slot("{bar"));
+    /** an empty or unclosed tag hashes the whole key */
+    CHECK(RedisClusterClient::Slot("foo{}{bar}") != RedisClusterClient::Slot("bar"));
+    CHECK(RedisClusterClient::Slot("foo{bar") != RedisClusterClient::Slot("bar"));
+}
+
+void TestSplitMget() {
+    std::vector<std::string> keys {"{a}1", "{b}1", "{a}2", "{c}1", "{b}2"};
+    std::vector<std::vector<std::string_view>> batches;
+    std::vector<std::vector<size_t>> positions;
+    RedisClusterClient::SplitMget(keys, batches, positions);
+    CHECK(batches.size() == 3);
+    CHECK(positions.size() == 3);
+    if (batches.size() != 3 || positions.size() != 3) {
+        return;
+    }
+    CHECK((batches[0] == std::vector<std::string_view> {"MGET", "{a}1", "{a}2"}));
+    CHECK((batches[1] == std::vector<std::string_view> {"MGET", "{b}1", "{b}2"}));
+    CHECK((batches[2] == std::vector<std::string_view> {"MGET", "{c}1"}));
+    CHECK((positions[0] == std::vector<size_t> {0, 2}));
+    CHECK((positions[1] == std::vector<size_t> {1, 4}));
+    CHECK((positions[2] == std::vector<size_t> {3}));
+
+    RedisClusterClient::SplitMget({}, batches, positions);
+    CHECK(batches.empty());
+    CHECK(positions.empty());
+}
+
+void TestSplitMset() {
+    std::vector<std::pair<std::string, std::string>> values {{"{a}1", "x"}, {"{b}1", "y"}, {"{a}2", "z"}};
+    auto batches = RedisClusterClient::SplitMset(values);
+    CHECK(batches.size() == 2);
+    if (batches.size() != 2) {
+        return;
+    }
+    CHECK((batches[0] == std::vector<std::string_view> {"MSET", "{a}1", "x", "{a}2", "z"}));
+    CHECK((batches[1] == std::vector<std::string_view> {"MSET", "{b}1", "y"}));
+    CHECK(RedisClusterClient::SplitMset({}).empty());
+}
+
+void TestParseRedirect() {
+    auto moved = RedisClusterClient::ParseRedirect("MOVED 3999 127.0.0.1:6381");
+    CHECK(moved.has_value());
+    if (moved) {
+        CHECK(!moved->ask);
+        CHECK(moved->slot == 3999);
+        CHECK(moved->target == "127.0.0.1:6381");
+    }
+    auto ask = RedisClusterClient::ParseRedirect("ASK 16383 redis-7.local:7000");
+    CHECK(ask.has_value());
+    if (ask) {
+        CHECK(ask->ask);
+        CHECK(ask->slot == 16383);
+        CHECK(ask->target == "redis-7.local:7000");
+    }
+    CHECK(!RedisClusterClient::ParseRedirect("ERR unknown command"));
+    CHECK(!RedisClusterClient::ParseRedirect("MOVEDX 1 127.0.0.1:6381"));
+    CHECK(!RedisClusterClient::ParseRedirect("MOVED 3999"));
+    CHECK(!RedisClusterClient::ParseRedirect("MOVED 3999 "));
+    CHECK(!RedisClusterClient::ParseRedirect("MOVED x 127.0.0.1:6381"));
+    CHECK(!RedisClusterClient::ParseRedirect("MOVED 16384 127.0.0.1:6381"));
+    CHECK(!RedisClusterClient::ParseRedirect(""));
+}
+
+} // namespace
+
+int main() {
+    TestSlot();
+    TestSplitMget();
+    TestSplitMset();
+    TestParseRedirect();
+    return CheckResult();
+}
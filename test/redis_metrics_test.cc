@@ -0,0 +1,135 @@
+/**
+ * @file redis_metrics_test.cc
+ * @author Keisum (Keisumhuis@gmail.com)
+ * @brief histogram buckets, percentiles and per command counters of RedisMetrics, no server needed
+ *        g++ -std=c++17 -I.. redis_metrics_test.cc ../redis_metrics.cc -lpthread
+ *        ./a.out, exits non-zero and names every failed check on stderr
+ * @version 0.1
+ * @date 2024-06-15
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "redis_metrics.h"
+#include "check.h"
+
+namespace {
+
+using Histogram = RedisLatencyHistogram;
+
+void TestBuckets() {
+    for (uint64_t nanos = 0; nanos < Histogram::kSubBuckets; ++nanos) {
+        CHECK(Histogram::BucketOf(nanos) == nanos);
+    }
+    /** 16 - 31 are still exact, 32 - 63 two wide and so on */
+    CHECK(Histogram::BucketOf(17) == 17);
+    CHECK(Histogram::BucketOf(32) == 32);
+    CHECK(Histogram::BucketOf(33) == 32);
+    CHECK(Histogram::BucketOf(34) == 33);
+    /** every bucket covers [LowerBound(b), LowerBound(b + 1)), contiguous and at most 1/16 of its lower bound wide */
+    for (size_t bucket = 0; bucket + 1 < Histogram::kBuckets; ++bucket) {
+        auto low = Histogram::LowerBound(bucket);
+        auto high = Histogram::LowerBound(bucket + 1) - 1;
+        CHECK(low <= high);
+        CHECK(Histogram::BucketOf(low) == bucket);
+        CHECK(Histogram::BucketOf(high) == bucket);
+        if (bucket >= Histogram::kSubBuckets) {
+            CHECK(high - low + 1 <= low / Histogram::kSubBuckets);
+        }
+    }
+    /** anything past the last octave lands in the last bucket */
+    CHECK(Histogram::BucketOf(Histogram::LowerBound(Histogram::kBuckets - 1)) == Histogram::kBuckets - 1);
+    CHECK(Histogram::BucketOf(std::numeric_limits<uint64_t>::max()) == Histogram::kBuckets - 1);
+}
+
+void Add(Histogram& histogram, uint64_t nanos, uint64_t times) {
+    histogram.counts[Histogram::BucketOf(nanos)] += times;
+    histogram.count += times;
+}
+
+void TestPercentile() {
+    Histogram empty;
+    CHECK(empty.Percentile(0.5) == 0);
+
+    Histogram single;
+    Add(single, 1000, 100);
+    for (double p : {0.0, 0.5, 1.0}) {
+        auto value = single.Percentile(p);
+        CHECK(value >= 1000 && value <= 1000 + 1000 / Histogram::kSubBuckets);
+    }
+
+    /** 90 fast calls and 10 slow ones */
+    Histogram mixed;
+    Add(mixed, 100, 90);
+    Add(mixed, 1000000, 10);
+    CHECK(mixed.Percentile(0.5) == Histogram::LowerBound(Histogram::BucketOf(100) + 1) - 1);
+    CHECK(mixed.Percentile(0.9) == mixed.Percentile(0.5));
+    CHECK(mixed.Percentile(0.91) >= 1000000);
+    CHECK(mixed.Percentile(0.91) <= 1000000 + 1000000 / Histogram::kSubBuckets);
+    CHECK(mixed.Percentile(0.999) == mixed.Percentile(0.91));
+    /** p outside 0 - 1 is clamped */
+    CHECK(mixed.Percentile(-1) == mixed.Percentile(0));
+    CHECK(mixed.Percentile(2) == mixed.Percentile(1));
+
+    Histogram exact;
+    Add(exact, 3, 1);
+    Add(exact, 7, 1);
+    CHECK(exact.Percentile(0.5) == 3);
+    CHECK(exact.Percentile(1) == 7);
+}
+
+void TestRequest() {
+    std::string formatted = "*2\r\n$3\r\nGET\r\n$1\r\nk\r\n";
+    CHECK(RedisMetrics::CommandOf(formatted.data(), formatted.size()) == "GET");
+    CHECK(RedisMetrics::RequestBytes({"GET", "k"}) == formatted.size());
+    CHECK(RedisMetrics::RequestBytes({"SET", "key", std::string_view("0123456789")}) == 39);
+}
+
+const RedisCommandStats* Find(const RedisMetricsSnapshot& snapshot, const std::string& command) {
+    for (auto& stats : snapshot.commands) {
+        if (stats.command == command) {
+            return &stats;
+        }
+    }
+    return nullptr;
+}
+
+void TestRecord() {
+    auto before = RedisMetrics::Snapshot();
+    redisReply ok {};
+    ok.type = REDIS_REPLY_STATUS;
+    redisReply error {};
+    error.type = REDIS_REPLY_ERROR;
+    RedisMetrics::Record("metricstest", 1000, 10, 5, &ok);
+    RedisMetrics::Record("MetricsTest", 3000, 10, 5, &error);
+    RedisMetrics::Record("METRICSTEST", 2000, 10, 0, nullptr);
+    auto delta = RedisMetrics::Snapshot().Since(before);
+    auto stats = Find(delta, "METRICSTEST");
+    CHECK(stats != nullptr);
+    if (!stats) {
+        return;
+    }
+    CHECK(stats->calls == 3);
+    CHECK(stats->errors == 2);
+    CHECK(stats->bytes_out == 30);
+    CHECK(stats->bytes_in == 10);
+    CHECK(stats->total_nanos == 6000);
+    CHECK(stats->max_nanos >= 3000);
+    CHECK(stats->latency.count == 3);
+    CHECK(stats->MeanMicros() == 2.0);
+}
+
+} // namespace
+
+int main() {
+    TestBuckets();
+    TestPercentile();
+    TestRequest();
+    TestRecord();
+    return CheckResult();
+}